@@ -1,10 +1,14 @@
 #include "Acceptor.h"
 #include "InetAddress.h"
 #include "Logger.h"
+#include "EventLoop.h"
+#include "IoUringPoller.h"
 
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <errno.h>
+#include <strings.h>
 
 static int createNonblocking()
 {
@@ -20,10 +24,12 @@ Acceptor::Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reusepor
     : loop_(loop),
       acceptSocket_(createNonblocking()),
       acceptChannal_(loop, acceptSocket_.fd()),
-      listenning_(false)
+      listenning_(false),
+      multishotAccept_(false),
+      acceptId_(0)
 {
     acceptSocket_.setReuseAddr(true);
-    acceptSocket_.setReusePort(true);
+    acceptSocket_.setReusePort(reuseport);
     acceptSocket_.bindAddress(listenAddr);
 
     acceptChannal_.setReadCallback(std::bind(&Acceptor::handleRead, this));
@@ -31,6 +37,10 @@ Acceptor::Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reusepor
 
 Acceptor::~Acceptor()
 {
+    if (acceptId_ != 0)
+    {
+        loop_->ioUringPoller()->cancel(acceptId_);
+    }
     acceptChannal_.disableAll();
     acceptChannal_.remove();
 }
@@ -39,7 +49,62 @@ void Acceptor::listen()
 {
     listenning_ = true;
     acceptSocket_.listen();
-    acceptChannal_.enableReading();
+    if (multishotAccept_ && loop_->ioUringPoller() != nullptr)
+    {
+        submitAccept();
+    }
+    else
+    {
+        acceptChannal_.enableReading();
+    }
+}
+
+void Acceptor::submitAccept()
+{
+    acceptId_ = loop_->ioUringPoller()->submitAccept(acceptSocket_.fd(),
+                                                     std::bind(&Acceptor::handleAcceptCompletion, this, std::placeholders::_1, std::placeholders::_3));
+    if (acceptId_ == 0)
+    {
+        // 提交失败时退回就绪通知
+        LOG_ERROR("%s:%s:%d submit accept failed\n", __FILE__, __FUNCTION__, __LINE__);
+        acceptChannal_.enableReading();
+    }
+}
+
+// accept请求完成，res为新连接的fd
+void Acceptor::handleAcceptCompletion(int res, bool more)
+{
+    if (!more)
+    {
+        acceptId_ = 0;
+    }
+
+    if (res >= 0)
+    {
+        sockaddr_in addr;
+        ::bzero(&addr, sizeof addr);
+        socklen_t len = sizeof addr;
+        ::getpeername(res, (sockaddr *)&addr, &len);
+        InetAddress peerAddr(addr);
+        if (newConnectionCallback_)
+        {
+            newConnectionCallback_(res, peerAddr);
+        }
+        else
+        {
+            ::close(res);
+        }
+    }
+    else if (res != -ECANCELED)
+    {
+        LOG_ERROR("%s:%s:%d listen socket accept err:%d\n", __FILE__, __FUNCTION__, __LINE__, -res);
+    }
+
+    // 内核结束了多次触发的请求(如出错)，重新提交
+    if (!more && res != -ECANCELED && listenning_)
+    {
+        submitAccept();
+    }
 }
 
 // listenfd发生事件，有新用户连接
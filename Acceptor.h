@@ -5,6 +5,7 @@
 #include "Channal.h"
 
 #include <functional>
+#include <stdint.h>
 
 class EventLoop;
 class InetAddress;
@@ -24,12 +25,22 @@ public:
 
     bool listenning()const{return listenning_;}
     void listen();
+
+    // loop使用io_uring后端时用多次触发的accept接受连接，需在listen之前设置
+    void setMultishotAccept(bool on) { multishotAccept_ = on; }
+
+    // 见Socket::attachReusePortCpuFilter，需在listen之后调用
+    bool attachCpuSteering(unsigned groupSize) { return acceptSocket_.attachReusePortCpuFilter(groupSize); }
 private:
     void handleRead();
+    void submitAccept();
+    void handleAcceptCompletion(int res, bool more);
 
     EventLoop *loop_; // 用户定义的baseloop/mainloop
     Socket acceptSocket_;//监听新连接消息的fd
     Channal acceptChannal_;
     NewConnectionCallback newConnectionCallback_;
     bool listenning_;
+    bool multishotAccept_;
+    uint64_t acceptId_; // 进行中的accept请求，0表示没有
 };
\ No newline at end of file
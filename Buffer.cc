@@ -1,39 +1,311 @@
 #include "Buffer.h"
+#include "BufferPool.h"
 
 #include <sys/uio.h>
 #include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
 #include <unistd.h>
+#include <string.h>
 
-// 从fd上读取数据
-ssize_t Buffer::readFd(int fd, int *savedErrno)
+const size_t Buffer::kCheapPrepend;
+const size_t Buffer::kInitialSize;
+const size_t Buffer::kDefaultBlockSize;
+const size_t Buffer::kMinReadSizeHint;
+const size_t Buffer::kMaxReadSizeHint;
+
+// 尚未申请内存的Buffer指向这里，保证begin()+kCheapPrepend总是合法的地址
+static char kEmptyStorage[Buffer::kCheapPrepend];
+
+Buffer::Buffer(size_t initialSize, BufferPool *pool)
+    : mode_(kContiguous),
+      pool_(pool),
+      data_(kEmptyStorage),
+      capacity_(kCheapPrepend),
+      initialSize_(initialSize),
+      readerIndex_(kCheapPrepend),
+      writerIndex_(kCheapPrepend),
+      blockSize_(kDefaultBlockSize),
+      chainReadable_(0),
+      readSizeHint_(kInitialSize),
+      readBudget_(0),
+      lastReadFilled_(false),
+      decreasePending_(false)
 {
-    char extrabuf[65536] = {0};
+    // 使用内存池时推迟到loop线程第一次写入时再申请
+    if (pool_ == nullptr)
+    {
+        data_ = allocate(kCheapPrepend + initialSize, &capacity_);
+    }
+}
 
-    struct iovec vec[2];
+Buffer::Buffer(Mode mode, BufferPool *pool, size_t blockSize)
+    : mode_(mode),
+      pool_(pool),
+      data_(kEmptyStorage),
+      capacity_(kCheapPrepend),
+      initialSize_(kInitialSize),
+      readerIndex_(kCheapPrepend),
+      writerIndex_(kCheapPrepend),
+      blockSize_(blockSize),
+      chainReadable_(0),
+      readSizeHint_(kInitialSize),
+      readBudget_(0),
+      lastReadFilled_(false),
+      decreasePending_(false)
+{
+}
 
-    const size_t writable = writeableBytes();
+Buffer::~Buffer()
+{
+    releaseStorage();
+    for (Block &block : blocks_)
+    {
+        releaseBlock(block);
+    }
+}
 
-    vec[0].iov_base = begin() + writerIndex_;
-    vec[0].iov_len = writable;
+Buffer::Buffer(Buffer &&rhs)
+    : mode_(rhs.mode_),
+      pool_(rhs.pool_),
+      data_(kEmptyStorage),
+      capacity_(kCheapPrepend),
+      initialSize_(rhs.initialSize_),
+      readerIndex_(kCheapPrepend),
+      writerIndex_(kCheapPrepend),
+      blockSize_(rhs.blockSize_),
+      chainReadable_(0),
+      readSizeHint_(rhs.readSizeHint_),
+      readBudget_(rhs.readBudget_),
+      lastReadFilled_(false),
+      decreasePending_(false)
+{
+    swap(rhs);
+}
 
-    vec[1].iov_base = extrabuf;
-    vec[1].iov_len = sizeof extrabuf;
+Buffer &Buffer::operator=(Buffer &&rhs)
+{
+    Buffer tmp(std::move(rhs));
+    swap(tmp);
+    return *this;
+}
 
-    const int iovcnt = (writable < sizeof extrabuf) ? 2 : 1;
-    const ssize_t n = ::readv(fd, vec, iovcnt);
+void Buffer::swap(Buffer &rhs)
+{
+    std::swap(mode_, rhs.mode_);
+    std::swap(pool_, rhs.pool_);
+    std::swap(data_, rhs.data_);
+    std::swap(capacity_, rhs.capacity_);
+    std::swap(initialSize_, rhs.initialSize_);
+    std::swap(readerIndex_, rhs.readerIndex_);
+    std::swap(writerIndex_, rhs.writerIndex_);
+    std::swap(blockSize_, rhs.blockSize_);
+    std::swap(chainReadable_, rhs.chainReadable_);
+    blocks_.swap(rhs.blocks_);
+    std::swap(readSizeHint_, rhs.readSizeHint_);
+    std::swap(readBudget_, rhs.readBudget_);
+    std::swap(lastReadFilled_, rhs.lastReadFilled_);
+    std::swap(decreasePending_, rhs.decreasePending_);
+}
+
+size_t Buffer::capacity() const
+{
+    if (mode_ == kChained)
+    {
+        size_t total = 0;
+        for (const Block &block : blocks_)
+        {
+            total += block.size;
+        }
+        return total;
+    }
+    return data_ == kEmptyStorage ? 0 : capacity_;
+}
+
+char *Buffer::allocate(size_t size, size_t *actualSize)
+{
+    if (pool_)
+    {
+        return pool_->allocate(size, actualSize);
+    }
+    *actualSize = size;
+    return static_cast<char *>(::malloc(size));
+}
+
+void Buffer::deallocate(char *data, size_t size)
+{
+    if (pool_)
+    {
+        pool_->deallocate(data, size);
+    }
+    else
+    {
+        ::free(data);
+    }
+}
+
+void Buffer::releaseStorage()
+{
+    if (data_ != kEmptyStorage)
+    {
+        deallocate(data_, capacity_);
+    }
+    data_ = kEmptyStorage;
+    capacity_ = kCheapPrepend;
+    readerIndex_ = writerIndex_ = kCheapPrepend;
+}
+
+void Buffer::shrinkIfDrained(size_t keepCapacity)
+{
+    if (readableBytes() != 0)
+    {
+        return;
+    }
+    if (mode_ == kChained)
+    {
+        if (capacity() > keepCapacity)
+        {
+            for (Block &block : blocks_)
+            {
+                releaseBlock(block);
+            }
+            blocks_.clear();
+        }
+    }
+    else if (capacity() > keepCapacity)
+    {
+        releaseStorage();
+    }
+}
+
+void Buffer::makeSpace(size_t len)
+{
+    if (mode_ == kChained)
+    {
+        blocks_.push_back(newBlock(std::max(len, blockSize_)));
+        return;
+    }
+
+    size_t readable = readableBytes();
+    if (writeableBytes() + prependableBytes() < len + kCheapPrepend)
+    {
+        // 申请新的内存，只需要拷贝可读数据
+        size_t size = std::max(kCheapPrepend + readable + len, kCheapPrepend + initialSize_);
+        if (data_ != kEmptyStorage)
+        {
+            size = std::max(size, capacity_ * 2);
+        }
+        size_t actual = 0;
+        char *data = allocate(size, &actual);
+        ::memcpy(data + kCheapPrepend, peek(), readable);
+        if (data_ != kEmptyStorage)
+        {
+            deallocate(data_, capacity_);
+        }
+        data_ = data;
+        capacity_ = actual;
+    }
+    else
+    {
+        ::memmove(data_ + kCheapPrepend, peek(), readable);
+    }
+    readerIndex_ = kCheapPrepend;
+    writerIndex_ = readerIndex_ + readable;
+}
+
+// 从fd上读取数据，设置了readBudget_时持续读取，直到读空或者达到预算
+ssize_t Buffer::readFd(int fd, int *savedErrno)
+{
+    size_t total = 0;
+    for (;;)
+    {
+        bool filled = false;
+        ssize_t n = (mode_ == kChained) ? chainReadFd(fd, savedErrno, &filled)
+                                        : readFdOnce(fd, savedErrno, &filled);
+        if (n <= 0)
+        {
+            // 已经读到过数据，EAGAIN/EOF/错误留给下一次读事件处理
+            return total > 0 ? static_cast<ssize_t>(total) : n;
+        }
+        total += n;
+        // 没有读满说明内核缓冲区已经读空，不必再多一次以EAGAIN结束的系统调用
+        if (!filled || total >= readBudget_)
+        {
+            return static_cast<ssize_t>(total);
+        }
+    }
+}
+
+// 每个线程复用一块溢出区，不用每次读事件都在栈上清零64K
+static __thread char t_extrabuf[65536];
+
+void Buffer::updateReadSizeHint(size_t n)
+{
+    if (n >= readSizeHint_)
+    {
+        readSizeHint_ = std::min(readSizeHint_ * 2, kMaxReadSizeHint);
+        decreasePending_ = false;
+    }
+    else if (n < readSizeHint_ / 2)
+    {
+        // 连续两次读到的数据都不足一半才缩小，避免来回抖动
+        if (decreasePending_)
+        {
+            readSizeHint_ = std::max(readSizeHint_ / 2, kMinReadSizeHint);
+            decreasePending_ = false;
+        }
+        else
+        {
+            decreasePending_ = true;
+        }
+    }
+    else
+    {
+        decreasePending_ = false;
+    }
+}
+
+// 按预测的读取大小准备尾部空间；预测稳定时只用一个缓冲区read，上一次读满时才带上溢出区
+ssize_t Buffer::readFdOnce(int fd, int *savedErrno, bool *filled)
+{
+    ensureWriteableBytes(readSizeHint_);
+    const size_t writable = writeableBytes();
+    const bool useExtra = lastReadFilled_ && writable < sizeof t_extrabuf;
+
+    ssize_t n = 0;
+    if (useExtra)
+    {
+        struct iovec vec[2];
+        vec[0].iov_base = begin() + writerIndex_;
+        vec[0].iov_len = writable;
+        vec[1].iov_base = t_extrabuf;
+        vec[1].iov_len = sizeof t_extrabuf;
+        n = ::readv(fd, vec, 2);
+    }
+    else
+    {
+        n = ::read(fd, begin() + writerIndex_, writable);
+    }
 
     if (n < 0)
     {
         *savedErrno = errno;
+        return n;
     }
-    else if (n < writable) // Buffer的可写缓冲区已经足够存储读出的数据
+
+    const size_t window = useExtra ? writable + sizeof t_extrabuf : writable;
+    lastReadFilled_ = static_cast<size_t>(n) == window;
+    *filled = lastReadFilled_;
+    updateReadSizeHint(n);
+
+    if (static_cast<size_t>(n) <= writable) // Buffer的可写缓冲区已经足够存储读出的数据
     {
         writerIndex_ += n;
     }
     else // extrabuf中也写入了数据
     {
-        writerIndex_ = buffer_.size();
-        append(extrabuf, n - writable);
+        writerIndex_ = capacity_;
+        append(t_extrabuf, n - writable);
     }
 
     return n;
@@ -41,10 +313,276 @@ ssize_t Buffer::readFd(int fd, int *savedErrno)
 
 ssize_t Buffer::writeFd(int fd, int *savedErrno)
 {
+    if (mode_ == kChained)
+    {
+        return chainWriteFd(fd, savedErrno);
+    }
+
     ssize_t n = ::write(fd, peek(), readableBytes());
     if (n < 0)
     {
         *savedErrno = errno;
     }
     return n;
-}
\ No newline at end of file
+}
+
+void Buffer::prepend(const void *data, size_t len)
+{
+    if (mode_ == kChained)
+    {
+        chainPrepend(data, len);
+        return;
+    }
+    // 还没有申请内存时不能写到共享的静态空白区里
+    if (data_ == kEmptyStorage)
+    {
+        makeSpace(initialSize_);
+    }
+    assert(len <= prependableBytes());
+    readerIndex_ -= len;
+    ::memcpy(begin() + readerIndex_, data, len);
+}
+
+const char *Buffer::pullup(size_t len)
+{
+    if (mode_ != kChained || contiguousReadableBytes() >= len)
+    {
+        return peek();
+    }
+
+    len = std::min(len, chainReadable_);
+    Block &front = blocks_.front();
+    if (front.size < len)
+    {
+        // 首块装不下，换一个足够大的块放在链首
+        Block block = newBlock(std::max(len, blockSize_));
+        ::memcpy(block.data, front.peek(), front.readable());
+        block.writeIndex = front.readable();
+        releaseBlock(front);
+        front = block;
+    }
+    else if (front.writeable() < len - front.readable())
+    {
+        ::memmove(front.data, front.peek(), front.readable());
+        front.writeIndex = front.readable();
+        front.readIndex = 0;
+    }
+
+    // 把后续块的数据搬到首块，直到首块有len字节可读
+    // 注意deque中间erase会使引用失效，每轮重新取首块
+    while (blocks_.front().readable() < len)
+    {
+        Block &head = blocks_.front();
+        Block &next = blocks_[1];
+        size_t n = std::min(len - head.readable(), next.readable());
+        ::memcpy(head.beginWrite(), next.peek(), n);
+        head.writeIndex += n;
+        next.readIndex += n;
+        if (next.readable() == 0)
+        {
+            releaseBlock(next);
+            blocks_.erase(blocks_.begin() + 1);
+        }
+    }
+    return blocks_.front().peek();
+}
+
+Buffer::Block Buffer::newBlock(size_t size)
+{
+    size_t actual = 0;
+    char *data = allocate(size, &actual);
+    return Block(data, actual);
+}
+
+void Buffer::releaseBlock(Block &block)
+{
+    if (block.data)
+    {
+        deallocate(block.data, block.size);
+        block.data = nullptr;
+    }
+}
+
+void Buffer::chainAppend(const char *data, size_t len)
+{
+    chainReadable_ += len;
+    while (len > 0)
+    {
+        if (blocks_.empty() || blocks_.back().writeable() == 0)
+        {
+            blocks_.push_back(newBlock(blockSize_));
+        }
+        Block &tail = blocks_.back();
+        size_t n = std::min(len, tail.writeable());
+        ::memcpy(tail.beginWrite(), data, n);
+        tail.writeIndex += n;
+        data += n;
+        len -= n;
+    }
+}
+
+void Buffer::chainRetrieve(size_t len)
+{
+    len = std::min(len, chainReadable_);
+    chainReadable_ -= len;
+    while (len > 0)
+    {
+        Block &front = blocks_.front();
+        size_t n = std::min(len, front.readable());
+        front.readIndex += n;
+        len -= n;
+        if (front.readable() == 0)
+        {
+            releaseBlock(front);
+            blocks_.pop_front();
+        }
+    }
+}
+
+void Buffer::copyOut(std::string *out, size_t len) const
+{
+    len = std::min(len, chainReadable_);
+    out->reserve(len);
+    for (const Block &block : blocks_)
+    {
+        if (len == 0)
+        {
+            break;
+        }
+        size_t n = std::min(len, block.readable());
+        out->append(block.peek(), n);
+        len -= n;
+    }
+}
+
+void Buffer::chainPrepend(const void *data, size_t len)
+{
+    if (blocks_.empty() || blocks_.front().readIndex < len)
+    {
+        // 首块前面放不下，在链首插入一个新块，数据写在块的末尾
+        Block block = newBlock(std::max(len, blockSize_));
+        block.readIndex = block.writeIndex = block.size;
+        blocks_.push_front(block);
+    }
+    Block &front = blocks_.front();
+    front.readIndex -= len;
+    ::memcpy(front.data + front.readIndex, data, len);
+    chainReadable_ += len;
+}
+
+void Buffer::chainPeekBytes(void *dst, size_t len) const
+{
+    char *out = static_cast<char *>(dst);
+    for (const Block &block : blocks_)
+    {
+        if (len == 0)
+        {
+            break;
+        }
+        size_t n = std::min(len, block.readable());
+        ::memcpy(out, block.peek(), n);
+        out += n;
+        len -= n;
+    }
+}
+
+// 链式模式：可读数据直接读入尾块的剩余空间以及新的块中，不经过额外的拷贝
+ssize_t Buffer::chainReadFd(int fd, int *savedErrno, bool *filled)
+{
+    static const int kMaxReadBlocks = 2;
+
+    struct iovec vec[kMaxReadBlocks + 1];
+    Block fresh[kMaxReadBlocks] = {newBlock(blockSize_), newBlock(blockSize_)};
+    int iovcnt = 0;
+
+    size_t tailWriteable = writeableBytes();
+    if (tailWriteable > 0)
+    {
+        vec[iovcnt].iov_base = blocks_.back().beginWrite();
+        vec[iovcnt].iov_len = tailWriteable;
+        ++iovcnt;
+    }
+    for (int i = 0; i < kMaxReadBlocks; ++i)
+    {
+        vec[iovcnt].iov_base = fresh[i].data;
+        vec[iovcnt].iov_len = fresh[i].size;
+        ++iovcnt;
+    }
+
+    const ssize_t n = ::readv(fd, vec, iovcnt);
+    if (n < 0)
+    {
+        *savedErrno = errno;
+    }
+    else
+    {
+        size_t left = static_cast<size_t>(n);
+        *filled = left == tailWriteable + kMaxReadBlocks * fresh[0].size;
+        chainReadable_ += left;
+
+        size_t m = std::min(left, tailWriteable);
+        if (m > 0)
+        {
+            blocks_.back().writeIndex += m;
+            left -= m;
+        }
+        for (int i = 0; i < kMaxReadBlocks; ++i)
+        {
+            if (left > 0)
+            {
+                fresh[i].writeIndex = std::min(left, fresh[i].size);
+                left -= fresh[i].writeIndex;
+                blocks_.push_back(fresh[i]);
+                fresh[i].data = nullptr;
+            }
+        }
+    }
+
+    // 未用上的新块还给内存池
+    for (int i = 0; i < kMaxReadBlocks; ++i)
+    {
+        releaseBlock(fresh[i]);
+    }
+    return n;
+}
+
+int Buffer::fillIovecs(struct iovec *vec, int maxIovecs) const
+{
+    int iovcnt = 0;
+    if (mode_ != kChained)
+    {
+        if (maxIovecs > 0 && readableBytes() > 0)
+        {
+            vec[0].iov_base = const_cast<char *>(peek());
+            vec[0].iov_len = readableBytes();
+            iovcnt = 1;
+        }
+        return iovcnt;
+    }
+
+    for (size_t i = 0; i < blocks_.size() && iovcnt < maxIovecs; ++i)
+    {
+        const Block &block = blocks_[i];
+        if (block.readable() > 0)
+        {
+            vec[iovcnt].iov_base = const_cast<char *>(block.peek());
+            vec[iovcnt].iov_len = block.readable();
+            ++iovcnt;
+        }
+    }
+    return iovcnt;
+}
+
+// 链式模式：所有块的可读数据通过一次writev发出
+ssize_t Buffer::chainWriteFd(int fd, int *savedErrno)
+{
+    struct iovec vec[IOV_MAX];
+    int iovcnt = fillIovecs(vec, IOV_MAX);
+
+    ssize_t n = iovcnt > 0 ? ::writev(fd, vec, iovcnt) : 0;
+    if (n < 0)
+    {
+        *savedErrno = errno;
+    }
+    return n;
+}
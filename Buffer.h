@@ -1,48 +1,116 @@
 #pragma once
 
-#include <vector>
+#include "ByteSearch.h"
+
+#include <deque>
 #include <cstddef>
 #include <string>
 #include <algorithm>
+#include <assert.h>
+#include <endian.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+
+class BufferPool;
+struct iovec;
 
 // 网络库底层的缓冲区类型
+/*
+ * 两种存储模式：
+ * kContiguous  一块连续内存 prependable | readable | writeable，扩容时可能整体拷贝
+ * kChained     若干固定大小的块组成的链，扩容只追加新块，不拷贝已有数据，适合大块数据的发送缓冲区
+ *              链式模式下 peek() 只指向首块的可读数据，contiguousReadableBytes() 为其长度
+ *
+ * 指定BufferPool时，内存从所属loop的内存池申请，并且推迟到第一次写入时才申请
+ */
 class Buffer
 {
 public:
     static const size_t kCheapPrepend = 8;
     static const size_t kInitialSize = 1024;
+    static const size_t kDefaultBlockSize = 16 * 1024;
+    static const size_t kMinReadSizeHint = 512;
+    static const size_t kMaxReadSizeHint = 64 * 1024;
 
-    explicit Buffer(size_t initialSize = kInitialSize)
-        : buffer_(kCheapPrepend + initialSize),
-          readerIndex_(kCheapPrepend),
-          writerIndex_(kCheapPrepend)
+    enum Mode
     {
-    }
+        kContiguous,
+        kChained
+    };
+
+    explicit Buffer(size_t initialSize = kInitialSize, BufferPool *pool = nullptr);
+    // 指定存储模式，blockSize为链式模式下每个块的大小
+    explicit Buffer(Mode mode, BufferPool *pool = nullptr, size_t blockSize = kDefaultBlockSize);
+    ~Buffer();
+
+    // 移动后rhs为空，但保留原来的存储模式、内存池和读取配置，可以继续使用
+    Buffer(Buffer &&rhs);
+    Buffer &operator=(Buffer &&rhs);
+    Buffer(const Buffer &) = delete;
+    Buffer &operator=(const Buffer &) = delete;
+
+    void swap(Buffer &rhs);
+
+    Mode mode() const { return mode_; }
 
     size_t readableBytes() const
     {
+        if (mode_ == kChained)
+        {
+            return chainReadable_;
+        }
+        return writerIndex_ - readerIndex_;
+    }
+
+    // peek()开始可以连续访问的字节数
+    size_t contiguousReadableBytes() const
+    {
+        if (mode_ == kChained)
+        {
+            return blocks_.empty() ? 0 : blocks_.front().readable();
+        }
         return writerIndex_ - readerIndex_;
     }
 
     size_t writeableBytes() const
     {
-        return buffer_.size() - writerIndex_;
+        if (mode_ == kChained)
+        {
+            return blocks_.empty() ? 0 : blocks_.back().writeable();
+        }
+        return capacity_ - writerIndex_;
     }
 
     size_t prependableBytes()
     {
+        if (mode_ == kChained)
+        {
+            return blocks_.empty() ? 0 : blocks_.front().readIndex;
+        }
         return readerIndex_;
     }
 
+    // 当前占用的内存大小
+    size_t capacity() const;
+
     // 返回缓冲区中可读数据的起始地址
     const char *peek() const
     {
+        if (mode_ == kChained)
+        {
+            return blocks_.empty() ? "" : blocks_.front().peek();
+        }
         return begin() + readerIndex_;
     }
 
     void retrieve(size_t len)
     {
-        if (len < readableBytes())
+        if (mode_ == kChained)
+        {
+            chainRetrieve(len);
+        }
+        else if (len < readableBytes())
         {
             readerIndex_ += len; // 只读取了可读缓冲区的前len长度的数据，还剩readerIndex_+=len ->writerIndex_的数据5
         }
@@ -54,6 +122,10 @@ public:
 
     void retrieveAll()
     {
+        if (mode_ == kChained)
+        {
+            chainRetrieve(chainReadable_);
+        }
         readerIndex_ = writerIndex_ = kCheapPrepend;
     }
 
@@ -65,11 +137,168 @@ public:
 
     std::string retrieveAsString(size_t len)
     {
+        if (mode_ == kChained)
+        {
+            std::string result;
+            copyOut(&result, len);
+            retrieve(len);
+            return result;
+        }
         std::string result(peek(), len);
         retrieve(len);
         return result;
     }
 
+    // 取走[peek(),end)之间的数据，end通常是findCRLF等查找的结果
+    void retrieveUntil(const char *end)
+    {
+        retrieve(end - peek());
+    }
+
+    // 在peek()开始可以连续访问的数据中查找，找不到返回nullptr
+    // 链式模式下只查找首块，需要时先调用pullup
+    const char *findCRLF() const
+    {
+        return findCRLF(peek());
+    }
+
+    const char *findCRLF(const char *start) const
+    {
+        return ByteSearch::findCRLF(start, peek() + contiguousReadableBytes());
+    }
+
+    const char *findEOL() const
+    {
+        return findByte('\n');
+    }
+
+    const char *findEOL(const char *start) const
+    {
+        return findByte('\n', start);
+    }
+
+    const char *findByte(char c) const
+    {
+        return findByte(c, peek());
+    }
+
+    const char *findByte(char c, const char *start) const
+    {
+        return ByteSearch::findByte(start, peek() + contiguousReadableBytes(), c);
+    }
+
+    // 以网络字节序读写整数，peek/read要求可读数据不少于整数的长度
+    void appendInt64(int64_t x)
+    {
+        int64_t be64 = htobe64(x);
+        append(reinterpret_cast<const char *>(&be64), sizeof be64);
+    }
+
+    void appendInt32(int32_t x)
+    {
+        int32_t be32 = htobe32(x);
+        append(reinterpret_cast<const char *>(&be32), sizeof be32);
+    }
+
+    void appendInt16(int16_t x)
+    {
+        int16_t be16 = htobe16(x);
+        append(reinterpret_cast<const char *>(&be16), sizeof be16);
+    }
+
+    void appendInt8(int8_t x)
+    {
+        append(reinterpret_cast<const char *>(&x), sizeof x);
+    }
+
+    int64_t peekInt64() const
+    {
+        int64_t be64 = 0;
+        peekBytes(&be64, sizeof be64);
+        return be64toh(be64);
+    }
+
+    int32_t peekInt32() const
+    {
+        int32_t be32 = 0;
+        peekBytes(&be32, sizeof be32);
+        return be32toh(be32);
+    }
+
+    int16_t peekInt16() const
+    {
+        int16_t be16 = 0;
+        peekBytes(&be16, sizeof be16);
+        return be16toh(be16);
+    }
+
+    int8_t peekInt8() const
+    {
+        int8_t x = 0;
+        peekBytes(&x, sizeof x);
+        return x;
+    }
+
+    int64_t readInt64()
+    {
+        int64_t result = peekInt64();
+        retrieve(sizeof result);
+        return result;
+    }
+
+    int32_t readInt32()
+    {
+        int32_t result = peekInt32();
+        retrieve(sizeof result);
+        return result;
+    }
+
+    int16_t readInt16()
+    {
+        int16_t result = peekInt16();
+        retrieve(sizeof result);
+        return result;
+    }
+
+    int8_t readInt8()
+    {
+        int8_t result = peekInt8();
+        retrieve(sizeof result);
+        return result;
+    }
+
+    // 写在可读数据之前，利用kCheapPrepend预留的空间，常用于补写长度头
+    void prependInt64(int64_t x)
+    {
+        int64_t be64 = htobe64(x);
+        prepend(&be64, sizeof be64);
+    }
+
+    void prependInt32(int32_t x)
+    {
+        int32_t be32 = htobe32(x);
+        prepend(&be32, sizeof be32);
+    }
+
+    void prependInt16(int16_t x)
+    {
+        int16_t be16 = htobe16(x);
+        prepend(&be16, sizeof be16);
+    }
+
+    void prependInt8(int8_t x)
+    {
+        prepend(&x, sizeof x);
+    }
+
+    void prepend(const void *data, size_t len);
+
+    // 链式模式下把前len字节整理到首块中，使peek()可以连续访问，返回peek()
+    const char *pullup(size_t len);
+
+    // 数据已经全部取走且占用的内存超过keepCapacity时，把内存还给内存池
+    void shrinkIfDrained(size_t keepCapacity);
+
     void ensureWriteableBytes(size_t len)
     {
         if (writeableBytes() < len)
@@ -81,6 +310,11 @@ public:
     // 将[data,data+len]的数据写入writeable缓冲区中
     void append(const char *data, size_t len)
     {
+        if (mode_ == kChained)
+        {
+            chainAppend(data, len);
+            return;
+        }
         ensureWriteableBytes(len);
         std::copy(data, data + len, beginWrite());
         writerIndex_ += len;
@@ -88,47 +322,123 @@ public:
 
     char *beginWrite()
     {
+        if (mode_ == kChained)
+        {
+            ensureWriteableBytes(1);
+            return blocks_.back().beginWrite();
+        }
         return begin() + writerIndex_;
     }
 
     const char *beginWrite() const
     {
+        if (mode_ == kChained)
+        {
+            return blocks_.empty() ? nullptr : blocks_.back().beginWrite();
+        }
         return begin() + writerIndex_;
     }
 
+    // 直接写入beginWrite()之后，更新可读数据的长度
+    void hasWritten(size_t len)
+    {
+        if (mode_ == kChained)
+        {
+            blocks_.back().writeIndex += len;
+            chainReadable_ += len;
+            return;
+        }
+        writerIndex_ += len;
+    }
+
     //从fd上读取数据
     ssize_t readFd(int fd,int *savedErrno);
+    // 一次readFd最多连续读取的字节数，0表示每次只读一次
+    void setReadBudget(size_t bytes) { readBudget_ = bytes; }
+    // 根据最近几次读到的数据量预测的下一次读取大小
+    size_t readSizeHint() const { return readSizeHint_; }
     //通过fd发送数据
     ssize_t writeFd(int fd,int *savedErrno);
+    // 把可读数据依次填入vec，最多maxIovecs个，返回使用的个数
+    int fillIovecs(struct iovec *vec, int maxIovecs) const;
 private:
+    // 链式模式中的一个块
+    struct Block
+    {
+        char *data;
+        size_t size;
+        size_t readIndex;
+        size_t writeIndex;
+
+        Block(char *d, size_t s)
+            : data(d), size(s), readIndex(0), writeIndex(0)
+        {
+        }
+
+        size_t readable() const { return writeIndex - readIndex; }
+        size_t writeable() const { return size - writeIndex; }
+        const char *peek() const { return data + readIndex; }
+        char *beginWrite() const { return data + writeIndex; }
+    };
+
     char *begin()
     {
-        return &*buffer_.begin();
+        return data_;
     }
 
     const char *begin() const
     {
-        return &*buffer_.begin();
+        return data_;
     }
 
-    void makeSpace(size_t len)
+    void makeSpace(size_t len);
+
+    char *allocate(size_t size, size_t *actualSize);
+    void deallocate(char *data, size_t size);
+    void releaseStorage();
+
+    Block newBlock(size_t size);
+    void releaseBlock(Block &block);
+    void chainAppend(const char *data, size_t len);
+    void chainRetrieve(size_t len);
+    void copyOut(std::string *out, size_t len) const;
+    void chainPrepend(const void *data, size_t len);
+
+    // 把前len字节拷贝到dst，不取走数据
+    void peekBytes(void *dst, size_t len) const
     {
-        if (writeableBytes() + prependableBytes() < len + kCheapPrepend)
-        {
-            buffer_.resize(writerIndex_ + len);
-        }
-        else
+        assert(readableBytes() >= len);
+        if (mode_ == kChained && contiguousReadableBytes() < len)
         {
-            size_t readable = readableBytes();
-            std::copy(buffer_.begin() + readerIndex_,
-                      buffer_.begin() + writerIndex_,
-                      buffer_.begin() + kCheapPrepend);
-            readerIndex_ = kCheapPrepend;
-            writerIndex_ = readerIndex_ + readable;
+            chainPeekBytes(dst, len);
+            return;
         }
+        ::memcpy(dst, peek(), len);
     }
+    void chainPeekBytes(void *dst, size_t len) const;
+    ssize_t chainReadFd(int fd, int *savedErrno, bool *filled);
+    ssize_t readFdOnce(int fd, int *savedErrno, bool *filled);
+    void updateReadSizeHint(size_t n);
+    ssize_t chainWriteFd(int fd, int *savedErrno);
+
+    Mode mode_;
+    BufferPool *pool_;
 
-    std::vector<char> buffer_;
+    // 连续模式使用，未申请内存时data_指向一个只有prepend区域的静态空白区
+    char *data_;
+    size_t capacity_;
+    size_t initialSize_;
     size_t readerIndex_;
     size_t writerIndex_;
-};
\ No newline at end of file
+
+    // 链式模式使用
+    size_t blockSize_;
+    size_t chainReadable_;
+    std::deque<Block> blocks_;
+
+    // 读取大小预测
+    size_t readSizeHint_;
+    size_t readBudget_;
+    bool lastReadFilled_;
+    bool decreasePending_;
+};
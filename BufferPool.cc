@@ -0,0 +1,148 @@
+#include "BufferPool.h"
+#include "CurrentThread.h"
+
+#include <stdlib.h>
+
+BufferPool::BufferPool()
+    : ownerTid_(CurrentThread::tid()),
+      maxCachedBytes_(kDefaultMaxCachedBytes),
+      cachedBytes_(0),
+      hugeInUseBytes_(0)
+{
+    for (SizeClass &sc : classes_)
+    {
+        sc.cached = 0;
+        sc.inUse = 0;
+        sc.hits = 0;
+        sc.misses = 0;
+    }
+}
+
+BufferPool::~BufferPool()
+{
+    trim();
+}
+
+size_t BufferPool::roundUp(size_t size)
+{
+    size_t classSize = size_t(1) << kMinClassShift;
+    while (classSize < size)
+    {
+        classSize <<= 1;
+    }
+    return classSize;
+}
+
+int BufferPool::classIndex(size_t size)
+{
+    for (size_t i = 0; i < kNumClasses; ++i)
+    {
+        if (size <= (size_t(1) << (kMinClassShift + i)))
+        {
+            return static_cast<int>(i);
+        }
+    }
+    return -1; // 超过最大等级
+}
+
+bool BufferPool::inOwnerThread() const
+{
+    return ownerTid_ == CurrentThread::tid();
+}
+
+char *BufferPool::allocate(size_t size, size_t *actualSize)
+{
+    int idx = classIndex(size);
+    if (idx < 0)
+    {
+        *actualSize = size;
+        hugeInUseBytes_.fetch_add(size, std::memory_order_relaxed);
+        return static_cast<char *>(::malloc(size));
+    }
+
+    SizeClass &sc = classes_[idx];
+    size_t classSize = size_t(1) << (kMinClassShift + idx);
+    *actualSize = classSize;
+    sc.inUse.fetch_add(1, std::memory_order_relaxed);
+
+    if (inOwnerThread() && !sc.freeList.empty())
+    {
+        char *data = sc.freeList.back();
+        sc.freeList.pop_back();
+        sc.cached.fetch_sub(1, std::memory_order_relaxed);
+        sc.hits.fetch_add(1, std::memory_order_relaxed);
+        cachedBytes_.fetch_sub(classSize, std::memory_order_relaxed);
+        return data;
+    }
+
+    sc.misses.fetch_add(1, std::memory_order_relaxed);
+    return static_cast<char *>(::malloc(classSize));
+}
+
+void BufferPool::deallocate(char *data, size_t size)
+{
+    if (data == nullptr)
+    {
+        return;
+    }
+
+    int idx = classIndex(size);
+    if (idx < 0)
+    {
+        hugeInUseBytes_.fetch_sub(size, std::memory_order_relaxed);
+        ::free(data);
+        return;
+    }
+
+    SizeClass &sc = classes_[idx];
+    sc.inUse.fetch_sub(1, std::memory_order_relaxed);
+
+    // 非loop线程归还或缓存已满，直接还给系统
+    if (!inOwnerThread() || cachedBytes_.load(std::memory_order_relaxed) + size > maxCachedBytes_)
+    {
+        ::free(data);
+        return;
+    }
+
+    sc.freeList.push_back(data);
+    sc.cached.fetch_add(1, std::memory_order_relaxed);
+    cachedBytes_.fetch_add(size, std::memory_order_relaxed);
+}
+
+void BufferPool::trim()
+{
+    for (size_t i = 0; i < kNumClasses; ++i)
+    {
+        SizeClass &sc = classes_[i];
+        for (char *data : sc.freeList)
+        {
+            ::free(data);
+        }
+        cachedBytes_.fetch_sub(sc.freeList.size() << (kMinClassShift + i), std::memory_order_relaxed);
+        sc.freeList.clear();
+        sc.cached = 0;
+    }
+}
+
+BufferPool::Stats BufferPool::stats() const
+{
+    Stats stats;
+    stats.cachedBytes = cachedBytes_.load(std::memory_order_relaxed);
+    stats.inUseBytes = 0;
+    stats.hugeInUseBytes = hugeInUseBytes_.load(std::memory_order_relaxed);
+    stats.classes.reserve(kNumClasses);
+    for (size_t i = 0; i < kNumClasses; ++i)
+    {
+        const SizeClass &sc = classes_[i];
+        ClassStats cs;
+        cs.blockSize = size_t(1) << (kMinClassShift + i);
+        cs.cached = sc.cached.load(std::memory_order_relaxed);
+        cs.inUse = sc.inUse.load(std::memory_order_relaxed);
+        cs.hits = sc.hits.load(std::memory_order_relaxed);
+        cs.misses = sc.misses.load(std::memory_order_relaxed);
+        stats.inUseBytes += cs.inUse * cs.blockSize;
+        stats.classes.push_back(cs);
+    }
+    stats.inUseBytes += stats.hugeInUseBytes;
+    return stats;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <vector>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <sys/types.h>
+
+/*
+ * 每个EventLoop一个的缓冲区内存池，按2的幂划分大小等级(1K ~ 1M)，每个等级维护一个空闲链表
+ * Buffer从所属loop的内存池申请、归还内存，避免连接频繁建立断开时反复调用malloc/free
+ * 空闲链表只在loop线程中访问，其它线程归还的内存直接free；统计数据可在任意线程读取
+ */
+class BufferPool : noncopyable
+{
+public:
+    static const size_t kMinClassShift = 10;                                  // 最小等级 1K
+    static const size_t kMaxClassShift = 20;                                  // 最大等级 1M
+    static const size_t kNumClasses = kMaxClassShift - kMinClassShift + 1;
+    static const size_t kDefaultMaxCachedBytes = 16 * 1024 * 1024;
+
+    // 单个大小等级的占用情况
+    struct ClassStats
+    {
+        size_t blockSize;
+        size_t cached;   // 空闲链表中的块数
+        size_t inUse;    // 已借出的块数
+        uint64_t hits;   // 从空闲链表中取得的次数
+        uint64_t misses; // 需要malloc的次数
+    };
+
+    struct Stats
+    {
+        size_t cachedBytes;
+        size_t inUseBytes;
+        size_t hugeInUseBytes; // 超过最大等级、不经过空闲链表的内存
+        std::vector<ClassStats> classes;
+    };
+
+    BufferPool();
+    ~BufferPool();
+
+    // 申请至少size字节，实际大小写入*actualSize
+    char *allocate(size_t size, size_t *actualSize);
+    // 归还allocate得到的内存，size为allocate返回的实际大小
+    void deallocate(char *data, size_t size);
+
+    // 释放所有缓存的空闲块
+    void trim();
+
+    void setMaxCachedBytes(size_t bytes) { maxCachedBytes_ = bytes; }
+    size_t maxCachedBytes() const { return maxCachedBytes_; }
+
+    Stats stats() const;
+
+    // 向上取整到所在的大小等级
+    static size_t roundUp(size_t size);
+
+private:
+    struct SizeClass
+    {
+        std::vector<char *> freeList;
+        std::atomic<size_t> cached;
+        std::atomic<size_t> inUse;
+        std::atomic<uint64_t> hits;
+        std::atomic<uint64_t> misses;
+    };
+
+    static int classIndex(size_t size);
+    bool inOwnerThread() const;
+
+    const pid_t ownerTid_; // 内存池所属loop的线程
+    size_t maxCachedBytes_;
+    std::atomic<size_t> cachedBytes_;
+    std::atomic<size_t> hugeInUseBytes_;
+    SizeClass classes_[kNumClasses];
+};
@@ -0,0 +1,155 @@
+#include "ByteSearch.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MYMUDUO_X86 1
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    using FindByteFunc = const char *(*)(const char *, const char *, char);
+    using FindCRLFFunc = const char *(*)(const char *, const char *);
+
+    const char *findByteScalar(const char *begin, const char *end, char c)
+    {
+        for (const char *p = begin; p < end; ++p)
+        {
+            if (*p == c)
+            {
+                return p;
+            }
+        }
+        return nullptr;
+    }
+
+    const char *findCRLFScalar(const char *begin, const char *end)
+    {
+        for (const char *p = begin; p + 1 < end; ++p)
+        {
+            if (p[0] == '\r' && p[1] == '\n')
+            {
+                return p;
+            }
+        }
+        return nullptr;
+    }
+
+#ifdef MYMUDUO_X86
+    const char *findByteSse2(const char *begin, const char *end, char c)
+    {
+        const __m128i needle = _mm_set1_epi8(c);
+        const char *p = begin;
+        for (; p + 16 <= end; p += 16)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, needle));
+            if (mask != 0)
+            {
+                return p + __builtin_ctz(mask);
+            }
+        }
+        return findByteScalar(p, end, c);
+    }
+
+    // 同时比较p和p+1两个偏移，一次得到所有'\r'后紧跟'\n'的位置
+    const char *findCRLFSse2(const char *begin, const char *end)
+    {
+        const __m128i cr = _mm_set1_epi8('\r');
+        const __m128i lf = _mm_set1_epi8('\n');
+        const char *p = begin;
+        for (; p + 17 <= end; p += 16)
+        {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 1));
+            int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, cr), _mm_cmpeq_epi8(b, lf)));
+            if (mask != 0)
+            {
+                return p + __builtin_ctz(mask);
+            }
+        }
+        return findCRLFScalar(p, end);
+    }
+
+    __attribute__((target("avx2"))) const char *findByteAvx2(const char *begin, const char *end, char c)
+    {
+        const __m256i needle = _mm256_set1_epi8(c);
+        const char *p = begin;
+        for (; p + 32 <= end; p += 32)
+        {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+            unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, needle)));
+            if (mask != 0)
+            {
+                return p + __builtin_ctz(mask);
+            }
+        }
+        return findByteSse2(p, end, c);
+    }
+
+    __attribute__((target("avx2"))) const char *findCRLFAvx2(const char *begin, const char *end)
+    {
+        const __m256i cr = _mm256_set1_epi8('\r');
+        const __m256i lf = _mm256_set1_epi8('\n');
+        const char *p = begin;
+        for (; p + 33 <= end; p += 32)
+        {
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+            __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 1));
+            unsigned mask = static_cast<unsigned>(
+                _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, cr), _mm256_cmpeq_epi8(b, lf))));
+            if (mask != 0)
+            {
+                return p + __builtin_ctz(mask);
+            }
+        }
+        return findCRLFSse2(p, end);
+    }
+#endif
+
+    struct Impl
+    {
+        FindByteFunc findByte;
+        FindCRLFFunc findCRLF;
+        const char *name;
+    };
+
+    Impl chooseImpl()
+    {
+#ifdef MYMUDUO_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+        {
+            return Impl{findByteAvx2, findCRLFAvx2, "avx2"};
+        }
+        if (__builtin_cpu_supports("sse2"))
+        {
+            return Impl{findByteSse2, findCRLFSse2, "sse2"};
+        }
+#endif
+        return Impl{findByteScalar, findCRLFScalar, "scalar"};
+    }
+
+    const Impl &impl()
+    {
+        static const Impl instance = chooseImpl();
+        return instance;
+    }
+}
+
+namespace ByteSearch
+{
+    const char *findByte(const char *begin, const char *end, char c)
+    {
+        return impl().findByte(begin, end, c);
+    }
+
+    const char *findCRLF(const char *begin, const char *end)
+    {
+        return impl().findCRLF(begin, end);
+    }
+
+    const char *implName()
+    {
+        return impl().name;
+    }
+}
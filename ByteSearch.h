@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+
+/*
+ * 在[begin,end)中查找分隔符，找不到返回nullptr
+ * x86下首次调用时按CPU支持的指令集选择AVX2/SSE2实现，其它平台使用逐字节的实现
+ */
+namespace ByteSearch
+{
+    // 查找字节c
+    const char *findByte(const char *begin, const char *end, char c);
+    // 查找"\r\n"，返回'\r'的位置
+    const char *findCRLF(const char *begin, const char *end);
+
+    // 当前使用的实现："avx2" "sse2" "scalar"
+    const char *implName();
+}
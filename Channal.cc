@@ -8,6 +8,7 @@
 const int Channal::kNoneEvent = 0;
 const int Channal::kReadEvent = EPOLLIN | EPOLLPRI;
 const int Channal::kWriteEvent = EPOLLOUT;
+const int Channal::kEdgeTriggered = EPOLLET;
 
 Channal::Channal(EventLoop *loop, int fd)
     : loop_(loop),
@@ -15,6 +16,9 @@ Channal::Channal(EventLoop *loop, int fd)
       events_(0),
       revents_(0),
       index_(-1),
+      edgeTriggered_(false),
+      requeuedEvents_(0),
+      ownerName_(nullptr),
       tied_(false)
 {
 }
@@ -39,8 +43,42 @@ void Channal::
     loop_->updateChannal(this);
 }
 
+void Channal::setEvents(int events)
+{
+    int oldPollEvents = pollEvents();
+    events_ = events;
+    if (!edgeTriggered_ || pollEvents() != oldPollEvents)
+    {
+        update();
+    }
+}
+
+bool Channal::setEdgeTriggered(bool on)
+{
+    on = on && loop_->supportsEdgeTriggered();
+    if (on != edgeTriggered_)
+    {
+        edgeTriggered_ = on;
+        if (!isNoneEvent())
+        {
+            update();
+        }
+    }
+    return edgeTriggered_;
+}
+
+void Channal::requeue(int revents)
+{
+    if (requeuedEvents_ == 0)
+    {
+        loop_->requeueChannal(this);
+    }
+    requeuedEvents_ |= revents;
+}
+
 void Channal::remove()
 {
+    requeuedEvents_ = 0;
     loop_->removeChannal(this);
 }
 
@@ -89,7 +127,8 @@ void Channal::handleEventWithGuard(Timestamp recviceTime)
             readCallback_(recviceTime);
         }
     }
-    if (revents_ & EPOLLOUT)
+    // 边沿触发时EPOLLOUT一直注册着，没有待发送数据时的可写通知直接忽略
+    if ((revents_ & EPOLLOUT) && (!edgeTriggered_ || isWriting()))
     {
         if (writeCallback_)
         {
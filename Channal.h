@@ -5,6 +5,7 @@
 
 #include <functional>
 #include <memory>
+#include <string>
 
 // 前置声明
 class EventLoop;
@@ -36,35 +37,36 @@ public:
 
     int fd() const { return fd_; };
     int events() const { return events_; }
+    int revents() const { return revents_; }
     void set_revents(int revt) { revents_ = revt; }
 
-    // 设置fd的相应事件状态
-    void enableReading()
-    {
-        events_ |= kReadEvent;
-        update();
-    }
-    void disableReading()
+    // 边沿触发：注册EPOLLET并始终关注EPOLLOUT，开关写事件不再需要epoll_ctl
+    // 回调需要把数据读写到EAGAIN；poller不支持时(io_uring后端)保持水平触发，返回false
+    bool setEdgeTriggered(bool on);
+    bool edgeTriggered() const { return edgeTriggered_; }
+    // 交给poller注册的事件
+    int pollEvents() const
     {
-        events_ &= ~kReadEvent;
-        update();
+        return edgeTriggered_ && events_ != kNoneEvent ? events_ | kWriteEvent | kEdgeTriggered : events_;
     }
-    void enableWriting()
-    {
-        events_ |= kWriteEvent;
-        update();
-    }
-    void disableWriting()
-    {
-        events_ &= kWriteEvent;
-        update();
-    }
-    void disableAll()
+
+    // 边沿触发时本次事件没有处理完(达到预算)，不会再有新的通知，在loop的下一轮迭代中以revents再处理一次
+    void requeue(int revents);
+    // 取出并清除等待再处理的事件，由EventLoop调用
+    int takeRequeuedEvents()
     {
-        events_ = kNoneEvent;
-        update();
+        int events = requeuedEvents_;
+        requeuedEvents_ = 0;
+        return events;
     }
 
+    // 设置fd的相应事件状态
+    void enableReading() { setEvents(events_ | kReadEvent); }
+    void disableReading() { setEvents(events_ & ~kReadEvent); }
+    void enableWriting() { setEvents(events_ | kWriteEvent); }
+    void disableWriting() { setEvents(events_ & ~kWriteEvent); }
+    void disableAll() { setEvents(kNoneEvent); }
+
     // 返回fd当前的事件状态
     bool isNoneEvent() const { return events_ == kNoneEvent; }
     bool isReading() const { return events_ & kReadEvent; }
@@ -74,9 +76,15 @@ public:
     void set_index(int idx) { index_ = idx; }
 
     EventLoop* ownerLoop(){return loop_;}
+
+    // 所属对象的名字(如TcpConnection的name)，用于看门狗等诊断输出；字符串需要比channal活得久
+    void setOwnerName(const std::string *name) { ownerName_ = name; }
+    const std::string *ownerName() const { return ownerName_; }
     void remove();
 
 private:
+    // 水平触发时每次都更新poller；边沿触发时注册的事件没有变化则不需要更新
+    void setEvents(int events);
     void update();
     void handleEventWithGuard(Timestamp recviceTime);
 
@@ -84,12 +92,16 @@ private:
     static const int kNoneEvent;
     static const int kReadEvent;
     static const int kWriteEvent;
+    static const int kEdgeTriggered;
 
     EventLoop *loop_; // 事件循环
     const int fd_;    // fd,Poller监听的对象
     int events_;      // 注册fd感兴趣的事件
     int revents_;     // Poller返回的具体发生的事件
     int index_;
+    bool edgeTriggered_;
+    int requeuedEvents_; // 等待在下一轮迭代中处理的事件
+    const std::string *ownerName_;
 
     std::weak_ptr<void> tie_;
     bool tied_;
@@ -0,0 +1,516 @@
+#pragma once
+
+/*
+ * 基于EventLoop和TcpConnection的C++20协程接口，只有头文件
+ * 库本身按c++11编译，使用方以-std=c++20编译时才会启用
+ *
+ * CoTask<T>       惰性启动的协程，被co_await时开始执行，结束后恢复等待它的协程
+ * coSpawn(task)   在当前线程立即开始执行task，不需要等待它的结果
+ * CoConnection    在连接上co_await read(n)/readUntil(delim)/write(data)
+ * coSleep(loop,s) s秒后在loop线程中恢复
+ * coPost(loop)    切换到loop线程中继续执行(当前就在loop线程中时相当于让出一次)
+ *
+ * 协程在完成事件的loop线程中直接恢复(消息回调、定时器回调、回调队列)，不经过额外的线程切换
+ * 协程帧由所在线程(也就是所属loop)的空闲链表分配和回收
+ */
+
+#if __cplusplus >= 202002L && defined(__cpp_impl_coroutine)
+
+#include "noncopyable.h"
+#include "EventLoop.h"
+#include "TcpConnection.h"
+#include "Buffer.h"
+#include "Logger.h"
+
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <new>
+#include <optional>
+#include <string>
+#include <utility>
+#include <algorithm>
+#include <stddef.h>
+
+// 协程帧分配器：按64字节分级的线程局部空闲链表，每级最多缓存kMaxCached个
+class CoFrameAllocator : noncopyable
+{
+public:
+    static void *allocate(size_t size)
+    {
+        size_t cls = sizeClass(size);
+        if (cls < kClasses)
+        {
+            Cache &cache = threadCache();
+            FreeBlock *block = cache.lists[cls];
+            if (block != nullptr)
+            {
+                cache.lists[cls] = block->next;
+                --cache.counts[cls];
+                return block;
+            }
+            return ::operator new((cls + 1) * kGranularity);
+        }
+        return ::operator new(size);
+    }
+
+    // 可以在其它线程中释放，块进入释放线程的链表
+    static void deallocate(void *ptr, size_t size)
+    {
+        size_t cls = sizeClass(size);
+        if (cls < kClasses)
+        {
+            Cache &cache = threadCache();
+            if (cache.counts[cls] < kMaxCached)
+            {
+                FreeBlock *block = static_cast<FreeBlock *>(ptr);
+                block->next = cache.lists[cls];
+                cache.lists[cls] = block;
+                ++cache.counts[cls];
+                return;
+            }
+        }
+        ::operator delete(ptr);
+    }
+
+private:
+    static const size_t kGranularity = 64;
+    static const size_t kClasses = 32; // 最大2KB，更大的帧直接使用operator new
+    static const size_t kMaxCached = 256;
+
+    struct FreeBlock
+    {
+        FreeBlock *next;
+    };
+
+    struct Cache
+    {
+        FreeBlock *lists[kClasses] = {};
+        size_t counts[kClasses] = {};
+
+        ~Cache()
+        {
+            for (size_t i = 0; i < kClasses; ++i)
+            {
+                while (lists[i] != nullptr)
+                {
+                    FreeBlock *next = lists[i]->next;
+                    ::operator delete(lists[i]);
+                    lists[i] = next;
+                }
+            }
+        }
+    };
+
+    static size_t sizeClass(size_t size) { return size == 0 ? 0 : (size - 1) / kGranularity; }
+
+    static Cache &threadCache()
+    {
+        static thread_local Cache cache;
+        return cache;
+    }
+};
+
+// 所有promise共用：帧的分配、异常的保存和结束后恢复等待者
+struct CoPromiseBase
+{
+    std::coroutine_handle<> continuation;
+    std::exception_ptr exception;
+
+    static void *operator new(size_t size) { return CoFrameAllocator::allocate(size); }
+    static void operator delete(void *ptr, size_t size) { CoFrameAllocator::deallocate(ptr, size); }
+
+    struct FinalAwaiter
+    {
+        bool await_ready() noexcept { return false; }
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+        {
+            std::coroutine_handle<> continuation = handle.promise().continuation;
+            return continuation ? continuation : std::noop_coroutine();
+        }
+        void await_resume() noexcept {}
+    };
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    FinalAwaiter final_suspend() noexcept { return {}; }
+    void unhandled_exception() { exception = std::current_exception(); }
+};
+
+template <typename T = void>
+class CoTask;
+
+// CoTask<T>与CoTask<void>的公共部分
+template <typename T, typename Promise>
+class CoTaskBase : noncopyable
+{
+public:
+    using Handle = std::coroutine_handle<Promise>;
+
+    CoTaskBase(CoTaskBase &&rhs) noexcept : handle_(std::exchange(rhs.handle_, nullptr)) {}
+    ~CoTaskBase()
+    {
+        if (handle_)
+        {
+            handle_.destroy();
+        }
+    }
+
+    // 被co_await时才开始执行，通过对称转移直接切换到task，不增加调用栈深度
+    bool await_ready() const noexcept { return !handle_ || handle_.done(); }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept
+    {
+        handle_.promise().continuation = caller;
+        return handle_;
+    }
+
+protected:
+    explicit CoTaskBase(Handle handle) : handle_(handle) {}
+
+    void rethrowIfFailed() const
+    {
+        if (handle_.promise().exception)
+        {
+            std::rethrow_exception(handle_.promise().exception);
+        }
+    }
+
+    Handle handle_;
+};
+
+template <typename T>
+struct CoTaskPromise : CoPromiseBase
+{
+    std::optional<T> value;
+
+    CoTask<T> get_return_object();
+    template <typename U>
+    void return_value(U &&v) { value.emplace(std::forward<U>(v)); }
+};
+
+template <>
+struct CoTaskPromise<void> : CoPromiseBase
+{
+    CoTask<void> get_return_object();
+    void return_void() {}
+};
+
+template <typename T>
+class CoTask : public CoTaskBase<T, CoTaskPromise<T>>
+{
+public:
+    using promise_type = CoTaskPromise<T>;
+    using Base = CoTaskBase<T, CoTaskPromise<T>>;
+
+    explicit CoTask(typename Base::Handle handle) : Base(handle) {}
+    CoTask(CoTask &&rhs) noexcept = default;
+
+    T await_resume()
+    {
+        this->rethrowIfFailed();
+        return std::move(*this->handle_.promise().value);
+    }
+};
+
+template <>
+class CoTask<void> : public CoTaskBase<void, CoTaskPromise<void>>
+{
+public:
+    using promise_type = CoTaskPromise<void>;
+    using Base = CoTaskBase<void, CoTaskPromise<void>>;
+
+    explicit CoTask(Base::Handle handle) : Base(handle) {}
+    CoTask(CoTask &&rhs) noexcept = default;
+
+    void await_resume() { rethrowIfFailed(); }
+};
+
+template <typename T>
+inline CoTask<T> CoTaskPromise<T>::get_return_object()
+{
+    return CoTask<T>(std::coroutine_handle<CoTaskPromise<T>>::from_promise(*this));
+}
+
+inline CoTask<void> CoTaskPromise<void>::get_return_object()
+{
+    return CoTask<void>(std::coroutine_handle<CoTaskPromise<void>>::from_promise(*this));
+}
+
+// coSpawn的返回值，立即开始执行，结束时自己释放帧
+struct CoDetached
+{
+    struct promise_type : CoPromiseBase
+    {
+        CoDetached get_return_object() { return CoDetached(); }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception()
+        {
+            try
+            {
+                throw;
+            }
+            catch (const std::exception &e)
+            {
+                LOG_ERROR("coroutine exited with exception: %s\n", e.what());
+            }
+            catch (...)
+            {
+                LOG_ERROR("coroutine exited with unknown exception\n");
+            }
+        }
+    };
+};
+
+inline CoDetached coSpawn(CoTask<void> task)
+{
+    co_await std::move(task);
+}
+
+// 在loop线程中seconds秒后恢复；loop先退出时协程不会再被恢复
+// 等待期间协程帧被销毁(需在loop线程中)时取消定时器，同一批到期、已经取不消的定时器也不会再恢复它
+class CoSleepAwaiter
+{
+public:
+    CoSleepAwaiter(EventLoop *loop, double seconds) : loop_(loop), seconds_(seconds) {}
+    ~CoSleepAwaiter()
+    {
+        if (pending_ && *pending_)
+        {
+            *pending_ = nullptr;
+            loop_->cancel(timerId_);
+        }
+    }
+
+    bool await_ready() const noexcept { return seconds_ <= 0; }
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        // 定时器回调与awaiter共享等待中的handle，恢复前清空，awaiter析构时据此判断是否还在等待
+        std::shared_ptr<std::coroutine_handle<>> pending = std::make_shared<std::coroutine_handle<>>(handle);
+        pending_ = pending;
+        timerId_ = loop_->runAfter(seconds_, [pending]() {
+            std::coroutine_handle<> handle = std::exchange(*pending, nullptr);
+            if (handle)
+            {
+                handle.resume();
+            }
+        });
+    }
+    void await_resume() noexcept {}
+
+private:
+    EventLoop *loop_;
+    double seconds_;
+    std::shared_ptr<std::coroutine_handle<>> pending_;
+    TimerId timerId_;
+};
+
+inline CoSleepAwaiter coSleep(EventLoop *loop, double seconds)
+{
+    return CoSleepAwaiter(loop, seconds);
+}
+
+// 通过loop的回调队列在loop线程中恢复
+class CoPostAwaiter
+{
+public:
+    explicit CoPostAwaiter(EventLoop *loop) : loop_(loop) {}
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        loop_->queueInLoop([handle]() { handle.resume(); });
+    }
+    void await_resume() noexcept {}
+
+private:
+    EventLoop *loop_;
+};
+
+inline CoPostAwaiter coPost(EventLoop *loop)
+{
+    return CoPostAwaiter(loop);
+}
+
+/*
+ * 连接上的协程读写，在连接所属loop线程中创建(通常在连接回调中)，之后的读写也要在该线程中进行
+ * 不要在消息回调和写完成回调中创建，它们正在执行时会被替换
+ * 创建时接管连接的消息回调、写完成回调和连接回调；连接断开时挂起的读写都会恢复
+ * 同一时刻最多有一个读和一个写在等待
+ */
+class CoConnection
+{
+    struct State;
+
+public:
+    explicit CoConnection(const TcpConnectionPtr &conn)
+        : conn_(conn),
+          state_(std::make_shared<State>())
+    {
+        std::shared_ptr<State> state = state_;
+        conn_->setMessageCallback([state](const TcpConnectionPtr &, Buffer *buf, Timestamp) {
+            state->input = buf;
+            ReadAwaiter *reader = state->reader;
+            if (reader != nullptr && reader->satisfied())
+            {
+                state->reader = nullptr;
+                reader->handle_.resume();
+            }
+        });
+        conn_->setWriteCompleteCallback([state](const TcpConnectionPtr &) {
+            state->resumeWriter();
+        });
+        conn_->setConnectionCallback([state](const TcpConnectionPtr &conn) {
+            if (!conn->connected())
+            {
+                state->closed = true;
+                ReadAwaiter *reader = std::exchange(state->reader, nullptr);
+                if (reader != nullptr)
+                {
+                    reader->handle_.resume();
+                }
+                state->resumeWriter();
+            }
+        });
+    }
+
+    const TcpConnectionPtr &connection() const { return conn_; }
+    bool closed() const { return state_->closed; }
+
+    class ReadAwaiter
+    {
+    public:
+        // 协程在挂起时被销毁(如外层CoTask被提前析构)，不能让消息回调再访问帧中的awaiter
+        ~ReadAwaiter()
+        {
+            if (state_ && state_->reader == this)
+            {
+                state_->reader = nullptr;
+            }
+        }
+
+        bool await_ready() { return satisfied(); }
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            handle_ = handle;
+            state_->reader = this;
+        }
+        // 读满n字节/读到delim(包括delim)；连接先断开时返回剩余的数据，长度不足或不以delim结尾
+        std::string await_resume()
+        {
+            Buffer *input = state_->input;
+            if (input == nullptr)
+            {
+                return std::string();
+            }
+            size_t len = std::min(found_, input->readableBytes());
+            return input->retrieveAsString(len);
+        }
+
+    private:
+        friend class CoConnection;
+
+        ReadAwaiter(const std::shared_ptr<State> &state, size_t n, std::string delim)
+            : state_(state), n_(n), delim_(std::move(delim)), scanned_(0), found_(std::string::npos) {}
+
+        bool satisfied()
+        {
+            Buffer *input = state_->input;
+            if (input != nullptr)
+            {
+                size_t readable = input->readableBytes();
+                if (delim_.empty())
+                {
+                    if (readable >= n_)
+                    {
+                        found_ = n_;
+                        return true;
+                    }
+                }
+                else if (readable >= delim_.size())
+                {
+                    // 从上次查找的位置继续，已经查找过的数据不会变化
+                    const char *data = input->pullup(readable);
+                    size_t start = scanned_ >= delim_.size() ? scanned_ - delim_.size() + 1 : 0;
+                    const char *pos = std::search(data + start, data + readable, delim_.begin(), delim_.end());
+                    scanned_ = readable;
+                    if (pos != data + readable)
+                    {
+                        found_ = pos - data + delim_.size();
+                        return true;
+                    }
+                }
+            }
+            return state_->closed;
+        }
+
+        std::shared_ptr<State> state_;
+        size_t n_;
+        std::string delim_;
+        size_t scanned_;
+        size_t found_; // 满足条件时要取出的长度
+        std::coroutine_handle<> handle_;
+    };
+
+    class WriteAwaiter
+    {
+    public:
+        // 与ReadAwaiter相同：挂起时帧被销毁，写完成回调不能再恢复它
+        ~WriteAwaiter()
+        {
+            if (handle_ && state_ && state_->writer == handle_)
+            {
+                state_->writer = nullptr;
+            }
+        }
+
+        bool await_ready() const noexcept { return state_->closed; }
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            handle_ = handle;
+            state_->writer = handle;
+            conn_->send(std::move(data_));
+        }
+        // 数据全部写入内核后返回true，连接断开返回false
+        bool await_resume() const noexcept { return !state_->closed; }
+
+    private:
+        friend class CoConnection;
+
+        WriteAwaiter(const TcpConnectionPtr &conn, const std::shared_ptr<State> &state, std::string data)
+            : conn_(conn), state_(state), data_(std::move(data)) {}
+
+        TcpConnectionPtr conn_;
+        std::shared_ptr<State> state_;
+        std::string data_;
+        std::coroutine_handle<> handle_;
+    };
+
+    ReadAwaiter read(size_t n) { return ReadAwaiter(state_, n, std::string()); }
+    ReadAwaiter readUntil(std::string delim) { return ReadAwaiter(state_, 0, std::move(delim)); }
+    WriteAwaiter write(std::string data) { return WriteAwaiter(conn_, state_, std::move(data)); }
+
+private:
+    struct State
+    {
+        Buffer *input = nullptr; // 第一次收到消息后才知道连接的输入缓冲区
+        bool closed = false;
+        ReadAwaiter *reader = nullptr;
+        std::coroutine_handle<> writer;
+
+        void resumeWriter()
+        {
+            std::coroutine_handle<> writer = std::exchange(this->writer, nullptr);
+            if (writer)
+            {
+                writer.resume();
+            }
+        }
+    };
+
+    TcpConnectionPtr conn_;
+    std::shared_ptr<State> state_;
+};
+
+#endif
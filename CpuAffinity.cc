@@ -0,0 +1,133 @@
+#include "CpuAffinity.h"
+#include "Logger.h"
+#include "CurrentThread.h"
+
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <dirent.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// <numaif.h>属于libnuma的开发包，这里只需要一个常量
+static const int kMpolPreferred = 1;
+
+bool CpuAffinity::parseCpuList(const std::string &list, std::vector<int> *cpus)
+{
+    cpus->clear();
+    const char *p = list.c_str();
+    while (*p != '\0')
+    {
+        char *end = nullptr;
+        long first = strtol(p, &end, 10);
+        if (end == p || first < 0)
+        {
+            return false;
+        }
+        long last = first;
+        p = end;
+        if (*p == '-')
+        {
+            ++p;
+            last = strtol(p, &end, 10);
+            if (end == p || last < first)
+            {
+                return false;
+            }
+            p = end;
+        }
+        for (long cpu = first; cpu <= last; ++cpu)
+        {
+            cpus->push_back(static_cast<int>(cpu));
+        }
+        if (*p == ',')
+        {
+            ++p;
+        }
+        else if (*p != '\0')
+        {
+            return false;
+        }
+    }
+    return !cpus->empty();
+}
+
+int CpuAffinity::nodeOfCpu(int cpu)
+{
+    // /sys/devices/system/cpu/cpuN/目录下有一个nodeM的链接
+    char path[64];
+    snprintf(path, sizeof path, "/sys/devices/system/cpu/cpu%d", cpu);
+    DIR *dir = ::opendir(path);
+    if (dir == nullptr)
+    {
+        return -1;
+    }
+    int node = -1;
+    struct dirent *entry;
+    while ((entry = ::readdir(dir)) != nullptr)
+    {
+        int n;
+        char extra;
+        if (sscanf(entry->d_name, "node%d%c", &n, &extra) == 1)
+        {
+            node = n;
+            break;
+        }
+    }
+    ::closedir(dir);
+    return node;
+}
+
+bool CpuAffinity::pinCurrentThread(int cpu)
+{
+    if (cpu < 0 || cpu >= CPU_SETSIZE)
+    {
+        LOG_ERROR("CpuAffinity::pinCurrentThread invalid cpu %d\n", cpu);
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (::sched_setaffinity(0, sizeof set, &set) < 0)
+    {
+        LOG_ERROR("CpuAffinity::pinCurrentThread cpu %d error:%d\n", cpu, errno);
+        return false;
+    }
+    return true;
+}
+
+bool CpuAffinity::preferMemoryNode(int node)
+{
+    const unsigned long kBitsPerLong = sizeof(unsigned long) * 8;
+    if (node < 0 || node >= static_cast<int>(kBitsPerLong))
+    {
+        LOG_ERROR("CpuAffinity::preferMemoryNode invalid node %d\n", node);
+        return false;
+    }
+    unsigned long mask = 1UL << node;
+    if (::syscall(SYS_set_mempolicy, kMpolPreferred, &mask, kBitsPerLong) < 0)
+    {
+        LOG_ERROR("CpuAffinity::preferMemoryNode node %d error:%d\n", node, errno);
+        return false;
+    }
+    return true;
+}
+
+bool CpuAffinity::placeCurrentThread(int cpu, bool bindNuma)
+{
+    if (!pinCurrentThread(cpu))
+    {
+        return false;
+    }
+    if (bindNuma)
+    {
+        int node = nodeOfCpu(cpu);
+        if (node < 0 || !preferMemoryNode(node))
+        {
+            return false;
+        }
+    }
+    LOG_INFO("thread %d pinned to cpu %d%s\n", CurrentThread::tid(), cpu, bindNuma ? " with local memory" : "");
+    return true;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+/*
+ * 线程的cpu亲和性和NUMA内存策略，只使用sched_setaffinity/set_mempolicy系统调用，不依赖libnuma
+ * 均作用于调用线程，因此要在loop线程中、创建EventLoop之前调用
+ */
+namespace CpuAffinity
+{
+    // 解析"0-3,8,10-11"形式的cpu列表
+    bool parseCpuList(const std::string &list, std::vector<int> *cpus);
+
+    // cpu所在的NUMA节点，不知道时返回-1
+    int nodeOfCpu(int cpu);
+
+    // 把调用线程固定到cpu上
+    bool pinCurrentThread(int cpu);
+
+    // 调用线程之后分配的内存优先使用node节点，节点内存不足时仍可以从其它节点分配
+    bool preferMemoryNode(int node);
+
+    // pinCurrentThread，bindNuma时再把内存策略设置为cpu所在的节点
+    bool placeCurrentThread(int cpu, bool bindNuma);
+}
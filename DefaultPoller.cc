@@ -1,5 +1,7 @@
 #include "Poller.h"
 #include "EpollPoller.h"
+#include "IoUringPoller.h"
+#include "Logger.h"
 
 #include <stdlib.h>
 
@@ -9,6 +11,17 @@ Poller* Poller::newDefaultPoller(EventLoop* loop)
     {
         return nullptr;//生成poll的实例
     }
+    else if(::getenv("MUDUO_USE_IOURING"))
+    {
+        IoUringPoller *poller = new IoUringPoller(loop);//生成io_uring的实例
+        if(poller->valid())
+        {
+            return poller;
+        }
+        LOG_ERROR("io_uring unavailable, fall back to epoll\n");
+        delete poller;
+        return new EpollPoller(loop);
+    }
     else
     {
         return new EpollPoller(loop);//生成epoll的实例
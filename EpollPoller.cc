@@ -17,7 +17,8 @@ const int kDeleted = 2;
 EpollPoller::EpollPoller(EventLoop *loop)
     : Poller(loop),
       epollfd_(::epoll_create1(EPOLL_CLOEXEC)),
-      events_(kInitEventListSize) // vevtor<epoll_event>
+      events_(kInitEventListSize), // vevtor<epoll_event>
+      lowUsagePolls_(0)
 {
     if (epollfd_ < 0)
     {
@@ -33,7 +34,11 @@ EpollPoller::~EpollPoller()
 // 重写基类Poller的抽象方法
 Timestamp EpollPoller::poll(int timeoutMs, ChannalList *activeChannals)
 {
-    LOG_INFO("func=%s => fd total count:%lu\n", __FUNCTION__, channals_.size());
+    // 忙轮询时以0超时频繁调用，不输出日志
+    if (timeoutMs != 0)
+    {
+        LOG_INFO("func=%s => fd total count:%lu\n", __FUNCTION__, numChannals());
+    }
 
     int numEvents = ::epoll_wait(epollfd_, &*events_.begin(), static_cast<int>(events_.size()), timeoutMs);
     int saveErrno = errno;
@@ -46,11 +51,28 @@ Timestamp EpollPoller::poll(int timeoutMs, ChannalList *activeChannals)
         if (numEvents == events_.size())
         {
             events_.resize(events_.size() * 2);
+            lowUsagePolls_ = 0;
+        }
+        else if (events_.size() > kInitEventListSize && static_cast<size_t>(numEvents) < events_.size() / 4)
+        {
+            // 突发连接过后列表不再需要这么大，减半并释放内存
+            if (++lowUsagePolls_ >= kShrinkAfterPolls)
+            {
+                EventList(events_.size() / 2).swap(events_);
+                lowUsagePolls_ = 0;
+            }
+        }
+        else
+        {
+            lowUsagePolls_ = 0;
         }
     }
     else if (numEvents == 0)
     {
-        LOG_DEBUG("%s timeout!\n", __FUNCTION__);
+        if (timeoutMs != 0)
+        {
+            LOG_DEBUG("%s timeout!\n", __FUNCTION__);
+        }
     }
     else
     {
@@ -60,7 +82,10 @@ Timestamp EpollPoller::poll(int timeoutMs, ChannalList *activeChannals)
             LOG_ERROR("EpollPoller::poll() err!");
         }
     }
-    LOG_INFO("poll(int timeoutMs, ChannalList *activeChannals)");
+    if (timeoutMs != 0)
+    {
+        LOG_INFO("poll(int timeoutMs, ChannalList *activeChannals)");
+    }
     return now;
 }
 
@@ -80,7 +105,7 @@ void EpollPoller::updateChannal(Channal *channal)
         if (index == kNew)
         {
             int fd = channal->fd();
-            channals_[fd] = channal;
+            setChannal(fd, channal);
         }
 
         channal->set_index(kAdded);
@@ -104,7 +129,7 @@ void EpollPoller::updateChannal(Channal *channal)
 void EpollPoller::removeChannal(Channal *channal)
 {
     int fd = channal->fd();
-    channals_.erase(fd);
+    clearChannal(fd);
 
     LOG_INFO("func=%s => fd=%d\n", __FUNCTION__, fd);
 
@@ -133,7 +158,7 @@ void EpollPoller::update(int operation, Channal *channal)
 {
     epoll_event event;
     bzero(&event, sizeof(event));
-    event.events = channal->events();
+    event.events = channal->pollEvents();
     int fd = channal->fd();
     event.data.fd = fd;
     event.data.ptr = channal;
@@ -23,9 +23,12 @@ public:
     Timestamp poll(int timeoutMs, ChannalList *activeChannals) override;
     void updateChannal(Channal *channal) override;
     void removeChannal(Channal *channal) override;
+    bool supportsEdgeTriggered() const override { return true; }
 
 private:
     static const int kInitEventListSize=16;
+    // 连续这么多次返回的事件不足列表的1/4时，列表减半
+    static const int kShrinkAfterPolls=1024;
 
     //填写活跃的连接
     void fillActiveChannals(int numEvents,ChannalList *activeChannals)const;
@@ -36,4 +39,5 @@ private:
 
     int epollfd_;
     EventList events_;
+    int lowUsagePolls_;
 };
\ No newline at end of file
@@ -2,18 +2,25 @@
 #include "Logger.h"
 #include "Poller.h"
 #include "Channal.h"
+#include "BufferPool.h"
+#include "TimerQueue.h"
+#include "IoUringPoller.h"
+#include "Watchdog.h"
 
 #include <sys/eventfd.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <memory>
+#include <algorithm>
 
 // 防止一个线程创建多个EventLoop
 __thread EventLoop *t_loopInThisThread = nullptr;
 
 // 定义默认的Poller io复用接口的超时时间
 const int kPollTimeMs = 10000;
+// 自适应的忙轮询时长不低于该值，避免事件密集时轮询时长被压到0
+const int64_t kMinSpinUs = 10;
 
 // 创建wakeupfd，用来notify唤醒subreactor处理新channal
 int createEventfd()
@@ -29,11 +36,31 @@ int createEventfd()
 EventLoop::EventLoop()
     : looping_(false),
       quit_(false),
-      callingPendingFunctors_(false),
       threadId_(CurrentThread::tid()),
       poller_(Poller::newDefaultPoller(this)),
+      ioUringPoller_(dynamic_cast<IoUringPoller *>(poller_.get())),
       wakeupFd_(createEventfd()),
-      wakeupChannal_(new Channal(this, wakeupFd_))
+      wakeupChannal_(new Channal(this, wakeupFd_)),
+      timerQueue_(new TimerQueue(this)),
+      bufferPool_(new BufferPool()),
+      maxSpinUs_(0),
+      spinBudgetUs_(0),
+      avgEventIntervalUs_(0),
+      spinUs_(0),
+      sleepUs_(0),
+      spinHits_(0),
+      spinMisses_(0),
+      callingPendingFunctors_(false),
+      wakeupPending_(false),
+      queuedSince_(0),
+      numConnections_(0),
+      heartbeat_(0),
+      activity_(kPolling),
+      currentFd_(-1),
+      currentChannal_(nullptr),
+      currentFunctor_(0),
+      functorBatch_(0),
+      watchdog_(nullptr)
 {
     LOG_DEBUG("EventLoop create %p in thread %d\n", this, threadId_);
     if (t_loopInThisThread)
@@ -54,6 +81,11 @@ EventLoop::EventLoop()
 
 EventLoop::~EventLoop()
 {
+    Watchdog *watchdog = watchdog_.load();
+    if (watchdog != nullptr)
+    {
+        watchdog->unwatch(this);
+    }
     wakeupChannal_->disableAll();
     wakeupChannal_->remove();
     ::close(wakeupFd_);
@@ -68,28 +100,157 @@ void EventLoop::loop()
 
     LOG_INFO("EventLoop %p start looping\n", this);
 
+    Timestamp iterationStart(Timestamp::now());
     while (!quit_)
     {
         activeChannals_.clear();
+        activity_.store(kPolling, std::memory_order_relaxed);
         // 监听两类fd clientfd、wakeupfd
-        pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannals_);
+        if (!requeuedChannals_.empty())
+        {
+            // 还有没处理完的channal，只取已经就绪的事件
+            for (Channal *channal : requeuedChannals_)
+            {
+                channal->set_revents(0);
+            }
+            pollReturnTime_ = poller_->poll(0, &activeChannals_);
+            mergeRequeuedChannals();
+        }
+        else if (maxSpinUs_.load(std::memory_order_relaxed) > 0)
+        {
+            pollReturnTime_ = busyPoll();
+        }
+        else
+        {
+            pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannals_);
+        }
 
+        metrics_.recordPollReturn(pollReturnTime_);
+        activity_.store(kHandlingEvents, std::memory_order_relaxed);
         for (Channal *channal : activeChannals_)
         {
+            currentChannal_ = channal;
+            currentFd_.store(channal->fd(), std::memory_order_relaxed);
+            beat();
             channal->handleEvent(pollReturnTime_);
         }
+        currentChannal_ = nullptr;
+        Timestamp eventsHandled(Timestamp::now());
         // 执行当前EventLoop需要处理的回调操作
         /*
          * IO线程 mainloop accept fd <<= channal -> subloop
          * mainloop 实现注册一个回调cb(subloop执行)      wakeup subloop后，执行下面的方法，执行之前mainloop注册的回调
          */
         doPendingFunctor();
+
+        // 本轮的结束时间就是下一轮的开始时间，每轮只多取两次时间
+        Timestamp iterationEnd(Timestamp::now());
+        metrics_.recordIteration(iterationStart, pollReturnTime_, eventsHandled, iterationEnd, activeChannals_.size());
+        iterationStart = iterationEnd;
     }
 
     LOG_INFO("EventLoop %p stop looping\n", this);
+    activity_.store(kPolling, std::memory_order_relaxed);
     looping_ = false;
 }
 
+void EventLoop::mergeRequeuedChannals()
+{
+    // poll之前清零了revents，revents不为0说明poll也返回了该channal，合并事件避免一轮处理两次
+    for (Channal *channal : requeuedChannals_)
+    {
+        int events = channal->takeRequeuedEvents();
+        if (channal->revents() == 0)
+        {
+            channal->set_revents(events);
+            activeChannals_.push_back(channal);
+        }
+        else
+        {
+            channal->set_revents(channal->revents() | events);
+        }
+    }
+    requeuedChannals_.clear();
+}
+
+Timestamp EventLoop::busyPoll()
+{
+    Timestamp start(Timestamp::now());
+    int64_t budget = spinBudgetUs_.load(std::memory_order_relaxed);
+    if (budget > 0)
+    {
+        int64_t spun = 0;
+        while (!quit_)
+        {
+            Timestamp now(poller_->poll(0, &activeChannals_));
+            spun = now.microSecondsSinceEpoch() - start.microSecondsSinceEpoch();
+            if (!activeChannals_.empty())
+            {
+                spinUs_.fetch_add(spun, std::memory_order_relaxed);
+                spinHits_.fetch_add(1, std::memory_order_relaxed);
+                updateBusyPollBudget(now);
+                return now;
+            }
+            if (spun >= budget)
+            {
+                break;
+            }
+        }
+        spinUs_.fetch_add(spun, std::memory_order_relaxed);
+        spinMisses_.fetch_add(1, std::memory_order_relaxed);
+        start = addTime(start, static_cast<double>(spun) / Timestamp::kMicroSecondsPerSecond);
+    }
+
+    Timestamp now(poller_->poll(kPollTimeMs, &activeChannals_));
+    sleepUs_.fetch_add(now.microSecondsSinceEpoch() - start.microSecondsSinceEpoch(), std::memory_order_relaxed);
+    if (!activeChannals_.empty())
+    {
+        updateBusyPollBudget(now);
+    }
+    return now;
+}
+
+void EventLoop::updateBusyPollBudget(Timestamp now)
+{
+    if (lastEventTime_.valid())
+    {
+        // 事件间隔的指数移动平均，权重1/8
+        int64_t interval = now.microSecondsSinceEpoch() - lastEventTime_.microSecondsSinceEpoch();
+        avgEventIntervalUs_ += (interval - avgEventIntervalUs_) / 8;
+    }
+    lastEventTime_ = now;
+
+    // 轮询两倍的平均间隔，大部分事件都能在轮询期间到达；平均间隔超过上限时轮询只会白白占用CPU
+    int64_t maxSpin = maxSpinUs_.load(std::memory_order_relaxed);
+    int64_t budget = avgEventIntervalUs_ * 2;
+    if (budget > maxSpin)
+    {
+        budget = 0;
+    }
+    else if (budget < kMinSpinUs)
+    {
+        budget = std::min(kMinSpinUs, maxSpin);
+    }
+    spinBudgetUs_.store(budget, std::memory_order_relaxed);
+}
+
+void EventLoop::setBusyPoll(int64_t maxSpinUs)
+{
+    maxSpinUs_ = maxSpinUs > 0 ? maxSpinUs : 0;
+    spinBudgetUs_ = maxSpinUs_.load();
+}
+
+EventLoop::BusyPollStats EventLoop::busyPollStats() const
+{
+    BusyPollStats stats;
+    stats.spinUs = spinUs_.load(std::memory_order_relaxed);
+    stats.sleepUs = sleepUs_.load(std::memory_order_relaxed);
+    stats.spinHits = spinHits_.load(std::memory_order_relaxed);
+    stats.spinMisses = spinMisses_.load(std::memory_order_relaxed);
+    stats.budgetUs = spinBudgetUs_.load(std::memory_order_relaxed);
+    return stats;
+}
+
 // 退出事件循环
 void EventLoop::quit()
 {
@@ -112,24 +273,59 @@ void EventLoop::runInLoop(Functor cb)
     }
     else // 不在当前loop线程中执行cb，需唤醒loop所在线程执行cb
     {
-        queueInLoop(cb);
+        queueInLoop(std::move(cb));
     }
 }
 // 把cb放入队列中，唤醒loop所在的线程执行cb
 void EventLoop::queueInLoop(Functor cb)
 {
+    // 记录这一批中最早的入队时间，只有每批的第一个回调需要取时间
+    // 在入队之前记录，doPendingFunctor先取回调个数再取时间戳，计入本批的回调记录的时间戳不会遗留到下一批
+    // 时间戳已记录、回调还没入队时被loop取走，这个回调会算入下一批，下一批的等待时间偏小
+    if (queuedSince_.load(std::memory_order_relaxed) == 0)
     {
-        std::unique_lock<std::mutex> lock(mutex_);
-        pendingFunctors_.emplace_back(cb);
+        int64_t expected = 0;
+        queuedSince_.compare_exchange_strong(expected, Timestamp::now().microSecondsSinceEpoch(), std::memory_order_relaxed);
+    }
+    if (pendingFunctors_.push(std::move(cb)))
+    {
+        // 环已满，cb进入了溢出队列
+        Task::recordHeapFallback();
     }
 
     // 唤醒相应的需要执行cb回调操作的loop的线程
+    // loop开始处理回调之前只需要唤醒一次，后续的cb会在同一轮中一起执行
     if (!isInLoopThread() || callingPendingFunctors_)
     {
-        wakeup();
+        if (!wakeupPending_.exchange(true))
+        {
+            wakeup();
+        }
     }
 }
 
+TimerId EventLoop::runAt(Timestamp time, TimerCallback cb)
+{
+    return timerQueue_->addTimer(std::move(cb), time, 0.0);
+}
+
+TimerId EventLoop::runAfter(double delay, TimerCallback cb)
+{
+    Timestamp time(addTime(Timestamp::now(), delay));
+    return runAt(time, std::move(cb));
+}
+
+TimerId EventLoop::runEvery(double interval, TimerCallback cb)
+{
+    Timestamp time(addTime(Timestamp::now(), interval));
+    return timerQueue_->addTimer(std::move(cb), time, interval);
+}
+
+void EventLoop::cancel(TimerId timerId)
+{
+    timerQueue_->cancel(timerId);
+}
+
 void EventLoop::handleRead()
 {
     uint64_t one = 1;
@@ -143,6 +339,7 @@ void EventLoop::handleRead()
 // 唤醒loop所在的线程  向wakeupfd写一个数据,wakeupchannal就会发生读事件，使eventloop解除处于poll的阻塞
 void EventLoop::wakeup()
 {
+    metrics_.recordWakeup();
     uint64_t one = 1;
     ssize_t n = write(wakeupFd_, &one, sizeof one);
     if (n != sizeof one)
@@ -159,6 +356,11 @@ void EventLoop::updateChannal(Channal *channal)
 
 void EventLoop::removeChannal(Channal *channal)
 {
+    ChannalList::iterator it = std::find(requeuedChannals_.begin(), requeuedChannals_.end(), channal);
+    if (it != requeuedChannals_.end())
+    {
+        requeuedChannals_.erase(it);
+    }
     poller_->removeChannal(channal);
 }
 
@@ -167,19 +369,40 @@ bool EventLoop::hasChannal(Channal *channal)
     return poller_->hasChannal(channal);
 }
 
+bool EventLoop::supportsEdgeTriggered() const
+{
+    return poller_->supportsEdgeTriggered();
+}
+
+void EventLoop::requeueChannal(Channal *channal)
+{
+    requeuedChannals_.push_back(channal);
+}
+
 // 执行回调
 void EventLoop::doPendingFunctor()
 {
-    std::vector<Functor> functors;
+    // 先清除唤醒标记再取回调，之后入队的cb会重新唤醒loop，不会遗漏
+    wakeupPending_ = false;
     callingPendingFunctors_ = true;
+    activity_.store(kPendingFunctors, std::memory_order_relaxed);
+
+    // 只执行进入本函数时已经入队的回调，执行期间新加入的留到下一轮，避免回调不断入队时饿死io事件
+    size_t n = pendingFunctors_.size();
+    // 在取个数之后取时间戳：size()与push同步，本批回调入队前记录的时间戳一定能在这里取到
+    // 反过来先取时间戳的话，取走之后记录、在size()之前入队的回调会把时间戳留给下一批，loop空闲多久等待时间就多算多久
+    int64_t queuedSince = queuedSince_.exchange(0, std::memory_order_relaxed);
+    if (n > 0)
     {
-        std::unique_lock<std::mutex> lock(mutex_);
-        functors.swap(pendingFunctors_);
+        int64_t waitUs = queuedSince > 0 ? Timestamp::now().microSecondsSinceEpoch() - queuedSince : -1;
+        metrics_.recordPendingFunctors(n, waitUs);
     }
-
-    // 执行当前loop需要执行的回调操作
-    for (const Functor &functor : functors)
+    functorBatch_.store(n, std::memory_order_relaxed);
+    Functor functor;
+    for (size_t i = 0; i < n && pendingFunctors_.pop(functor); ++i)
     {
+        currentFunctor_.store(i, std::memory_order_relaxed);
+        beat();
         functor();
     }
     callingPendingFunctors_ = false;
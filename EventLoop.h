@@ -3,21 +3,29 @@
 #include "noncopyable.h"
 #include "Timestamp.h"
 #include "CurrentThread.h"
+#include "Callbacks.h"
+#include "TimerId.h"
+#include "MpscQueue.h"
+#include "Task.h"
+#include "LoopMetrics.h"
 
 #include <functional>
 #include <vector>
 #include <atomic>
 #include <memory>
-#include <mutex>
 
 class Channal;
 class Poller;
+class BufferPool;
+class TimerQueue;
+class IoUringPoller;
+class Watchdog;
 
 // 事件循环类，主要包含 Channal 和 Poller（epoll的抽象) 两个模块
 class EventLoop : noncopyable
 {
 public:
-    using Functor = std::function<void()>;
+    using Functor = Task; // 只能移动，小闭包不需要堆分配
 
     EventLoop();
     ~EventLoop();
@@ -29,6 +37,33 @@ public:
 
     Timestamp pollReturnTime() const { return pollReturnTime_; }
 
+    // 忙轮询：没有事件时先以0超时反复poll，最多maxSpinUs微秒仍没有事件才阻塞等待，省去线程睡眠和唤醒的延迟
+    // 实际轮询时长按事件到达的平均间隔自适应，事件稀疏时不再轮询；0表示关闭
+    void setBusyPoll(int64_t maxSpinUs);
+
+    struct BusyPollStats
+    {
+        int64_t spinUs;      // 忙轮询花费的时间
+        int64_t sleepUs;     // 阻塞在poll中的时间
+        uint64_t spinHits;   // 轮询期间等到了事件的次数
+        uint64_t spinMisses; // 轮询超时后转入阻塞等待的次数
+        int64_t budgetUs;    // 当前的轮询时长
+    };
+    BusyPollStats busyPollStats() const;
+
+    // 运行统计：每轮耗时、poll等待时间、事件数、io事件和回调的处理时间、回调队列深度和等待时间、唤醒次数
+    // 可以在任意线程调用
+    LoopMetrics::Snapshot metrics() const { return metrics_.snapshot(); }
+    // 可以在任意线程调用，见LoopMetrics::busyTime
+    void busyTime(uint64_t *busyUs, uint64_t *totalUs) const { metrics_.busyTime(busyUs, totalUs); }
+    // 当前这一轮还没有结束的忙碌时间，卡在某个回调中的loop不会完成迭代，只能从这里看出来
+    uint64_t unfinishedBusyUs() const { return metrics_.unfinishedBusyUs(Timestamp::now()); }
+
+    // 属于该loop的连接数：TcpConnection构造时(分配连接的线程中)加一，connectDestroyed时减一
+    int numConnections() const { return numConnections_.load(std::memory_order_relaxed); }
+    void connectionCreated() { numConnections_.fetch_add(1, std::memory_order_relaxed); }
+    void connectionDestroyed() { numConnections_.fetch_sub(1, std::memory_order_relaxed); }
+
     // 在当前loop中执行cb
     void runInLoop(Functor cb);
     // 把cb放入队列中，唤醒loop所在的线程执行cb
@@ -37,18 +72,56 @@ public:
     // 唤醒loop所在的线程
     void wakeup();
 
+    // 定时器，可以在任意线程调用，回调在loop线程中执行
+    // 在time时刻执行cb
+    TimerId runAt(Timestamp time, TimerCallback cb);
+    // delay秒后执行cb
+    TimerId runAfter(double delay, TimerCallback cb);
+    // 每隔interval秒执行一次cb
+    TimerId runEvery(double interval, TimerCallback cb);
+    // 取消定时器
+    void cancel(TimerId timerId);
+
     // EventLoop的方法=>Poller的方法
     void updateChannal(Channal *channal);
     void removeChannal(Channal *channal);
     bool hasChannal(Channal *channal);
+    bool supportsEdgeTriggered() const;
+    // 边沿触发的channal本轮没有处理完，下一轮迭代中与poll返回的channal一起处理，期间poll不阻塞
+    void requeueChannal(Channal *channal);
 
     // 判断EventLoop对象是否在自己的线程里面
     bool isInLoopThread() const { return threadId_ == CurrentThread::tid(); }
 
+    // 该loop上所有连接的缓冲区共用的内存池
+    BufferPool *bufferPool() const { return bufferPool_.get(); }
+    // 使用io_uring后端时返回其Poller，可以提交完成模式的请求；否则返回nullptr
+    IoUringPoller *ioUringPoller() const { return ioUringPoller_; }
+
 private:
+    friend class Watchdog;
+
+    // 看门狗读取的运行状态
+    enum Activity
+    {
+        kPolling,         // 在poll中等待，不算卡顿
+        kHandlingEvents,  // 处理io事件
+        kPendingFunctors, // 执行回调
+    };
+    // 每处理一个io事件或回调心跳加一，只有loop线程写入
+    void beat() { heartbeat_.store(heartbeat_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); }
+
     void handleRead();       // 处理weakup
     void doPendingFunctor(); // 执行回调
 
+    // 把上一轮requeue的channal并入activeChannals_
+    void mergeRequeuedChannals();
+
+    // 开启忙轮询时的poll，先轮询再阻塞
+    Timestamp busyPoll();
+    // 有事件到达时更新平均间隔和轮询时长
+    void updateBusyPollBudget(Timestamp now);
+
     using ChannalList = std::vector<Channal *>;
 
     std::atomic_bool looping_;
@@ -58,6 +131,7 @@ private:
 
     Timestamp pollReturnTime_; // poller返回发生事件的channals的时间点
     std::unique_ptr<Poller> poller_;
+    IoUringPoller *ioUringPoller_; // poller_是IoUringPoller时指向它
 
     /*
      * 主要作用，当mainloop获取一个新用户的channal，通过轮询算法选择一个subloop，通过该成员唤醒subloop处理
@@ -67,9 +141,35 @@ private:
     int wakeupFd_;
     std::unique_ptr<Channal> wakeupChannal_;
 
+    std::unique_ptr<TimerQueue> timerQueue_;
+
     ChannalList activeChannals_;
+    ChannalList requeuedChannals_; // 等待下一轮迭代继续处理的channal
+
+    std::unique_ptr<BufferPool> bufferPool_;
+
+    std::atomic<int64_t> maxSpinUs_;
+    std::atomic<int64_t> spinBudgetUs_;
+    int64_t avgEventIntervalUs_;
+    Timestamp lastEventTime_;
+    std::atomic<int64_t> spinUs_;
+    std::atomic<int64_t> sleepUs_;
+    std::atomic<uint64_t> spinHits_;
+    std::atomic<uint64_t> spinMisses_;
 
     std::atomic_bool callingPendingFunctors_; // 标识当前loop是否有需要执行的回调操作
-    std::vector<Functor> pendingFunctors_;    // 存储loop需要执行的所有回调操作
-    std::mutex mutex_;                        // 互斥锁，用来保护上面vector容器的线程安全操作
+    MpscQueue<Functor> pendingFunctors_;      // 存储loop需要执行的所有回调操作，其它线程无锁追加，环满时溢出
+    std::atomic_bool wakeupPending_;          // 已经写过wakeupfd、loop还没有开始处理回调，不需要再唤醒
+    std::atomic<int64_t> queuedSince_;        // 当前这批回调中最早的入队时间，0表示没有
+
+    LoopMetrics metrics_;
+    std::atomic<int> numConnections_;
+
+    std::atomic<uint64_t> heartbeat_;
+    std::atomic<int> activity_;
+    std::atomic<int> currentFd_;         // 正在处理的channal的fd
+    Channal *currentChannal_;            // 只在loop线程中读写(包括看门狗的信号处理函数)
+    std::atomic<size_t> currentFunctor_; // 正在执行本批回调中的第几个
+    std::atomic<size_t> functorBatch_;   // 本批回调的个数
+    std::atomic<Watchdog *> watchdog_;   // 监视该loop的看门狗，析构时unwatch
 };
\ No newline at end of file
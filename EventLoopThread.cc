@@ -1,5 +1,6 @@
 #include "EventLoopThread.h"
 #include "EventLoop.h"
+#include "CpuAffinity.h"
 
 EventLoopThread::EventLoopThread(const ThreadInitCallback &cb, const std::string &name)
     : loop_(nullptr),
@@ -7,7 +8,9 @@ EventLoopThread::EventLoopThread(const ThreadInitCallback &cb, const std::string
       thread_(std::bind(&EventLoopThread::threadFunc, this)),
       mutex_(),
       cond_(),
-      callback_(cb)
+      callback_(cb),
+      cpu_(-1),
+      bindNuma_(false)
 {
 }
 
@@ -40,6 +43,11 @@ EventLoop *EventLoopThread::startLoop()
 // 此方法运行在新创建的线程中
 void EventLoopThread::threadFunc()
 {
+    // 在创建EventLoop之前设置，poller和缓冲区等内存都分配在本地节点上
+    if (cpu_ >= 0)
+    {
+        CpuAffinity::placeCurrentThread(cpu_, bindNuma_);
+    }
     EventLoop loop;
 
     if (callback_)
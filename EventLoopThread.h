@@ -17,6 +17,9 @@ public:
     EventLoopThread(const ThreadInitCallback &cb=ThreadInitCallback(),const std::string &name=std::string());
     ~EventLoopThread();
 
+    // 在startLoop之前设置：loop线程固定到cpu上，bindNuma时内存优先分配在cpu所在的NUMA节点
+    void setCpu(int cpu, bool bindNuma) { cpu_ = cpu; bindNuma_ = bindNuma; }
+
     EventLoop* startLoop();
 
 private:
@@ -28,4 +31,6 @@ private:
     std::mutex mutex_;
     std::condition_variable cond_;
     ThreadInitCallback callback_;
+    int cpu_; // -1表示不固定
+    bool bindNuma_;
 };
\ No newline at end of file
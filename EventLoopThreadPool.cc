@@ -1,5 +1,7 @@
 #include "EventLoopThreadPool.h"
 #include "EventLoopThread.h"
+#include "EventLoop.h"
+#include "CpuAffinity.h"
 
 #include <memory>
 
@@ -8,7 +10,10 @@ EventLoopThreadPool::EventLoopThreadPool(EventLoop *baseloop, const std::string
       name_(nameArg),
       started_(false),
       numThreads_(0),
-      next_(0)
+      next_(0),
+      dispatcher_(LoopDispatcher::newDispatcher(LoopDispatcher::kRoundRobin)),
+      baseLoopCpu_(-1),
+      numaBind_(false)
 {
 }
 
@@ -24,11 +29,23 @@ void EventLoopThreadPool::start(const ThreadInitCallBack &cb)
         char buf[name_.size() + 32];
         snprintf(buf, sizeof(buf), "%s%d", name_.c_str(), i);
         EventLoopThread *t = new EventLoopThread(cb, buf);
+        if (!threadCpus_.empty())
+        {
+            t->setCpu(threadCpus_[i % threadCpus_.size()], numaBind_);
+        }
         threads_.push_back(std::unique_ptr<EventLoopThread>(t));
         // 创建一个线程，绑定一个新EventLoop，并返回该loop的地址
         loops_.push_back(t->startLoop());
     }
 
+    // 新线程继承创建者的亲和性和内存策略，subloop线程都创建完之后才固定baseloop，
+    // 否则没有指定cpu的subloop会全部挤在baseloop的cpu上
+    if (baseLoopCpu_ >= 0)
+    {
+        // 亲和性和内存策略只能作用于调用线程
+        baseloop_->runInLoop(std::bind(&CpuAffinity::placeCurrentThread, baseLoopCpu_, numaBind_));
+    }
+
     // 整个服务端只有一个线程，运行baseloop
     if (numThreads_ == 0 && cb)
     {
@@ -53,6 +70,15 @@ EventLoop *EventLoopThreadPool::getNextLoop()
     return loop;
 }
 
+EventLoop *EventLoopThreadPool::getLoopForConnection(const InetAddress &peerAddr)
+{
+    if (loops_.empty())
+    {
+        return baseloop_;
+    }
+    return dispatcher_->select(loops_, peerAddr);
+}
+
 std::vector<EventLoop *> EventLoopThreadPool::getAllLoops()
 {
     if (loops_.empty())
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "noncopyable.h"
+#include "LoopDispatcher.h"
 
 #include <vector>
 #include <functional>
@@ -9,6 +10,7 @@
 
 class EventLoop;
 class EventLoopThread;
+class InetAddress;
 
 class EventLoopThreadPool : noncopyable
 {
@@ -21,10 +23,24 @@ public:
 
     void setTreadNum(int numThreads) { numThreads_ = numThreads; }
 
+    // 以下需在start之前设置
+    // 第i个subloop固定到cpus[i % cpus.size()]上，为空时不固定
+    void setThreadCpus(const std::vector<int> &cpus) { threadCpus_ = cpus; }
+    // baseloop固定到cpu上，在start创建完subloop线程之后于baseloop线程中生效
+    // 新线程继承创建者的亲和性和内存策略，之后在baseloop线程中创建的线程(如WorkerPool)也会被固定到该cpu
+    void setBaseLoopCpu(int cpu) { baseLoopCpu_ = cpu; }
+    // 固定cpu的loop的内存优先分配在cpu所在的NUMA节点
+    void setNumaBind(bool on) { numaBind_ = on; }
+
     void start(const ThreadInitCallBack &cb = ThreadInitCallBack());
 
     EventLoop *getNextLoop();
 
+    // 按分配策略为新连接选择loop，默认轮询；需在start之前设置
+    void setDispatchPolicy(LoopDispatcher::Policy policy) { dispatcher_.reset(LoopDispatcher::newDispatcher(policy)); }
+    void setDispatcher(std::unique_ptr<LoopDispatcher> dispatcher) { dispatcher_ = std::move(dispatcher); }
+    EventLoop *getLoopForConnection(const InetAddress &peerAddr);
+
     std::vector<EventLoop *> getAllLoops();
 
     bool started() const { return started_; }
@@ -38,4 +54,8 @@ private:
     int next_;
     std::vector<std::unique_ptr<EventLoopThread>> threads_;
     std::vector<EventLoop *> loops_;
+    std::unique_ptr<LoopDispatcher> dispatcher_;
+    std::vector<int> threadCpus_;
+    int baseLoopCpu_;
+    bool numaBind_;
 };
\ No newline at end of file
@@ -0,0 +1,71 @@
+#include "Histogram.h"
+
+#include <stdio.h>
+
+const int Histogram::kBuckets;
+
+Histogram::Histogram()
+    : count_(0),
+      sum_(0),
+      max_(0)
+{
+    for (int i = 0; i < kBuckets; ++i)
+    {
+        buckets_[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+Histogram::Snapshot Histogram::snapshot() const
+{
+    Snapshot snap;
+    snap.count = count_.load(std::memory_order_relaxed);
+    snap.sum = sum_.load(std::memory_order_relaxed);
+    snap.max = max_.load(std::memory_order_relaxed);
+    for (int i = 0; i < kBuckets; ++i)
+    {
+        snap.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+    }
+    return snap;
+}
+
+uint64_t Histogram::Snapshot::percentile(double p) const
+{
+    uint64_t total = 0;
+    for (int i = 0; i < kBuckets; ++i)
+    {
+        total += buckets[i];
+    }
+    if (total == 0)
+    {
+        return 0;
+    }
+
+    uint64_t rank = static_cast<uint64_t>(p * total);
+    if (rank >= total)
+    {
+        rank = total - 1;
+    }
+    uint64_t seen = 0;
+    for (int i = 0; i < kBuckets; ++i)
+    {
+        seen += buckets[i];
+        if (seen > rank)
+        {
+            // 桶i的上界为2^i-1，不超过实际的最大值
+            uint64_t upper = i == 0 ? 0 : (1ULL << i) - 1;
+            return upper < max ? upper : max;
+        }
+    }
+    return max;
+}
+
+std::string Histogram::Snapshot::toString() const
+{
+    char buf[128];
+    snprintf(buf, sizeof buf, "count=%lu mean=%.1f p50=%lu p99=%lu max=%lu",
+             static_cast<unsigned long>(count), mean(),
+             static_cast<unsigned long>(percentile(0.5)),
+             static_cast<unsigned long>(percentile(0.99)),
+             static_cast<unsigned long>(max));
+    return buf;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <atomic>
+#include <string>
+#include <stdint.h>
+
+/*
+ * 以2的幂为桶边界的直方图：桶0记录0，桶i(i>0)记录[2^(i-1), 2^i)
+ * 只能由一个线程(所属loop的线程)写入，写入是relaxed的load+store，没有锁也没有原子读改写
+ * 其它线程可以随时无锁地取快照，快照中各个计数之间可能相差正在进行的一次记录
+ */
+class Histogram : noncopyable
+{
+public:
+    static const int kBuckets = 32;
+
+    struct Snapshot
+    {
+        uint64_t count;
+        uint64_t sum;
+        uint64_t max;
+        uint64_t buckets[kBuckets];
+
+        double mean() const { return count > 0 ? static_cast<double>(sum) / count : 0.0; }
+        // 第p(0~1)分位数所在桶的上界
+        uint64_t percentile(double p) const;
+        // count= mean= p50= p99= max=
+        std::string toString() const;
+    };
+
+    Histogram();
+
+    void record(uint64_t value)
+    {
+        add(buckets_[bucketOf(value)], 1);
+        add(count_, 1);
+        add(sum_, value);
+        if (value > max_.load(std::memory_order_relaxed))
+        {
+            max_.store(value, std::memory_order_relaxed);
+        }
+    }
+
+    Snapshot snapshot() const;
+
+    static int bucketOf(uint64_t value)
+    {
+        if (value == 0)
+        {
+            return 0;
+        }
+        int bucket = 64 - __builtin_clzll(value);
+        return bucket < kBuckets ? bucket : kBuckets - 1;
+    }
+
+private:
+    // 单写者，不需要fetch_add
+    static void add(std::atomic<uint64_t> &counter, uint64_t n)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    std::atomic<uint64_t> buckets_[kBuckets];
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> sum_;
+    std::atomic<uint64_t> max_;
+};
@@ -0,0 +1,233 @@
+#include "IoUring.h"
+#include "Logger.h"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+
+static int sysIoUringSetup(unsigned entries, struct io_uring_params *p)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, p));
+}
+
+static int sysIoUringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags, void *arg, size_t argSize)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, arg, argSize));
+}
+
+static int sysIoUringRegister(int fd, unsigned opcode, void *arg, unsigned nrArgs)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg, nrArgs));
+}
+
+IoUring::IoUring()
+    : ringFd_(-1),
+      features_(0),
+      sqRing_(MAP_FAILED),
+      sqRingSize_(0),
+      sqHead_(nullptr),
+      sqTail_(nullptr),
+      sqMask_(nullptr),
+      sqArray_(nullptr),
+      sqes_(static_cast<struct io_uring_sqe *>(MAP_FAILED)),
+      sqesSize_(0),
+      sqEntries_(0),
+      sqeTail_(0),
+      submitted_(0),
+      cqRing_(MAP_FAILED),
+      cqRingSize_(0),
+      cqHead_(nullptr),
+      cqTail_(nullptr),
+      cqMask_(nullptr),
+      cqes_(nullptr)
+{
+}
+
+IoUring::~IoUring()
+{
+    unmapRings();
+    if (ringFd_ >= 0)
+    {
+        ::close(ringFd_);
+    }
+}
+
+void IoUring::unmapRings()
+{
+    if (sqes_ != MAP_FAILED)
+    {
+        ::munmap(sqes_, sqesSize_);
+        sqes_ = static_cast<struct io_uring_sqe *>(MAP_FAILED);
+    }
+    if (cqRing_ != MAP_FAILED && cqRing_ != sqRing_)
+    {
+        ::munmap(cqRing_, cqRingSize_);
+    }
+    cqRing_ = MAP_FAILED;
+    if (sqRing_ != MAP_FAILED)
+    {
+        ::munmap(sqRing_, sqRingSize_);
+        sqRing_ = MAP_FAILED;
+    }
+}
+
+bool IoUring::init(unsigned entries)
+{
+    struct io_uring_params params;
+    ::memset(&params, 0, sizeof params);
+    // 完成队列是提交队列的两倍，空闲连接上挂着的poll请求不占用提交队列
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = entries * 2;
+
+    int fd = sysIoUringSetup(entries, &params);
+    if (fd < 0)
+    {
+        LOG_ERROR("io_uring_setup error:%d\n", errno);
+        return false;
+    }
+    // 需要io_uring_enter带超时参数(5.11)以及完成队列溢出时不丢事件
+    unsigned required = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG;
+    if ((params.features & required) != required)
+    {
+        LOG_ERROR("io_uring features 0x%x not supported\n", params.features);
+        ::close(fd);
+        return false;
+    }
+
+    sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (cqRingSize_ > sqRingSize_)
+    {
+        sqRingSize_ = cqRingSize_;
+    }
+    cqRingSize_ = sqRingSize_;
+
+    sqRing_ = ::mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sqRing_ == MAP_FAILED)
+    {
+        LOG_ERROR("io_uring mmap sq ring error:%d\n", errno);
+        ::close(fd);
+        return false;
+    }
+    cqRing_ = sqRing_; // IORING_FEAT_SINGLE_MMAP，两个环形队列共用一次映射
+
+    sqesSize_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    void *sqes = ::mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+    {
+        LOG_ERROR("io_uring mmap sqes error:%d\n", errno);
+        unmapRings();
+        ::close(fd);
+        return false;
+    }
+    sqes_ = static_cast<struct io_uring_sqe *>(sqes);
+
+    char *sq = static_cast<char *>(sqRing_);
+    sqHead_ = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sqMask_ = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sqArray_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    sqEntries_ = params.sq_entries;
+    sqeTail_ = *sqTail_;
+    submitted_ = sqeTail_;
+
+    char *cq = static_cast<char *>(cqRing_);
+    cqHead_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cqMask_ = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe *>(cq + params.cq_off.cqes);
+
+    ringFd_ = fd;
+    features_ = params.features;
+    return true;
+}
+
+struct io_uring_sqe *IoUring::getSqe()
+{
+    unsigned head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+    if (sqeTail_ - head >= sqEntries_)
+    {
+        submit();
+        head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+        if (sqeTail_ - head >= sqEntries_)
+        {
+            return nullptr;
+        }
+    }
+    unsigned index = sqeTail_ & *sqMask_;
+    struct io_uring_sqe *sqe = &sqes_[index];
+    ::memset(sqe, 0, sizeof *sqe);
+    sqArray_[index] = index;
+    ++sqeTail_;
+    return sqe;
+}
+
+int IoUring::enter(unsigned toSubmit, unsigned minComplete, unsigned flags, void *arg, size_t argSize)
+{
+    // 把本地填写的提交项发布给内核
+    __atomic_store_n(sqTail_, sqeTail_, __ATOMIC_RELEASE);
+    int ret = sysIoUringEnter(ringFd_, toSubmit, minComplete, flags, arg, argSize);
+    if (ret >= 0)
+    {
+        submitted_ += static_cast<unsigned>(ret);
+    }
+    return ret;
+}
+
+int IoUring::submit()
+{
+    unsigned toSubmit = pendingSubmissions();
+    if (toSubmit == 0)
+    {
+        return 0;
+    }
+    return enter(toSubmit, 0, 0, nullptr, 0);
+}
+
+int IoUring::submitAndWait(int timeoutMs)
+{
+    unsigned toSubmit = pendingSubmissions();
+    unsigned flags = IORING_ENTER_GETEVENTS;
+    if (timeoutMs == 0)
+    {
+        // 不等待，只让内核处理已经就绪的完成事件(poll的完成在本线程进入内核时才写入完成队列)
+        return enter(toSubmit, 0, flags, nullptr, 0);
+    }
+    if (timeoutMs < 0)
+    {
+        return enter(toSubmit, 1, flags, nullptr, 0);
+    }
+
+    struct __kernel_timespec ts;
+    ts.tv_sec = timeoutMs / 1000;
+    ts.tv_nsec = static_cast<long long>(timeoutMs % 1000) * 1000 * 1000;
+    struct io_uring_getevents_arg arg;
+    ::memset(&arg, 0, sizeof arg);
+    arg.ts = reinterpret_cast<uint64_t>(&ts);
+    return enter(toSubmit, 1, flags | IORING_ENTER_EXT_ARG, &arg, sizeof arg);
+}
+
+struct io_uring_cqe *IoUring::peekCqe()
+{
+    unsigned head = *cqHead_;
+    unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+    if (head == tail)
+    {
+        return nullptr;
+    }
+    return &cqes_[head & *cqMask_];
+}
+
+void IoUring::cqeSeen()
+{
+    __atomic_store_n(cqHead_, *cqHead_ + 1, __ATOMIC_RELEASE);
+}
+
+int IoUring::registerOp(unsigned opcode, void *arg, unsigned nrArgs)
+{
+    return sysIoUringRegister(ringFd_, opcode, arg, nrArgs);
+}
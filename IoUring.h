@@ -0,0 +1,69 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <linux/io_uring.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * io_uring的薄封装，直接使用io_uring_setup/io_uring_enter系统调用和mmap映射的环形队列，不依赖liburing
+ * 只在所属loop线程中使用，提交队列和完成队列都只有一个使用者
+ */
+class IoUring : noncopyable
+{
+public:
+    IoUring();
+    ~IoUring();
+
+    // 创建entries大小的提交队列，内核不支持io_uring或缺少需要的特性时返回false
+    bool init(unsigned entries);
+    bool valid() const { return ringFd_ >= 0; }
+    int fd() const { return ringFd_; }
+    unsigned features() const { return features_; }
+
+    // 取得一个空闲的提交项并清零，提交队列已满时先把已有的提交给内核
+    struct io_uring_sqe *getSqe();
+    // 尚未提交给内核的提交项个数
+    unsigned pendingSubmissions() const { return sqeTail_ - submitted_; }
+
+    // 提交所有待提交的请求，不等待完成
+    int submit();
+    // 提交所有待提交的请求，并等待至少一个完成事件，timeoutMs<0表示一直等待，0表示不等待
+    int submitAndWait(int timeoutMs);
+
+    // 取出下一个完成事件，没有时返回nullptr；处理完后调用cqeSeen
+    struct io_uring_cqe *peekCqe();
+    void cqeSeen();
+
+    // io_uring_register，如注册provided buffer ring
+    int registerOp(unsigned opcode, void *arg, unsigned nrArgs);
+
+private:
+    int enter(unsigned toSubmit, unsigned minComplete, unsigned flags, void *arg, size_t argSize);
+    void unmapRings();
+
+    int ringFd_;
+    unsigned features_;
+
+    // 提交队列
+    void *sqRing_;
+    size_t sqRingSize_;
+    unsigned *sqHead_;
+    unsigned *sqTail_;
+    unsigned *sqMask_;
+    unsigned *sqArray_;
+    struct io_uring_sqe *sqes_;
+    size_t sqesSize_;
+    unsigned sqEntries_;
+    unsigned sqeTail_;   // 本地已填写的提交项位置
+    unsigned submitted_; // 已经发布给内核的位置
+
+    // 完成队列
+    void *cqRing_;
+    size_t cqRingSize_;
+    unsigned *cqHead_;
+    unsigned *cqTail_;
+    unsigned *cqMask_;
+    struct io_uring_cqe *cqes_;
+};
@@ -0,0 +1,412 @@
+#include "IoUringPoller.h"
+#include "Channal.h"
+#include "Logger.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <algorithm>
+#include <sys/mman.h>
+#include <sys/socket.h>
+
+// 取消命令的user_data，完成事件直接忽略
+static const uint64_t kCancelUserData = 0;
+
+const unsigned IoUringPoller::kBufRingEntries;
+const unsigned IoUringPoller::kBufSize;
+const uint16_t IoUringPoller::kBufGroup;
+
+IoUringPoller::IoUringPoller(EventLoop *loop)
+    : Poller(loop),
+      nextGeneration_(1),
+      nextCompletionId_(2),
+      bufRing_(nullptr),
+      bufRingSize_(0),
+      bufBase_(nullptr),
+      bufTail_(0)
+{
+    ring_.init(kRingEntries);
+}
+
+IoUringPoller::~IoUringPoller()
+{
+    if (bufRing_ != nullptr)
+    {
+        struct io_uring_buf_reg reg;
+        ::memset(&reg, 0, sizeof reg);
+        reg.bgid = kBufGroup;
+        ring_.registerOp(IORING_UNREGISTER_PBUF_RING, &reg, 1);
+        ::munmap(bufRing_, bufRingSize_);
+    }
+}
+
+bool IoUringPoller::enableCompletion()
+{
+    if (bufRing_ != nullptr)
+    {
+        return true;
+    }
+    if (!ring_.valid())
+    {
+        return false;
+    }
+
+    // ring的描述项和所有缓冲区放在同一块匿名映射中，描述项在前，按页对齐
+    size_t ringBytes = kBufRingEntries * sizeof(struct io_uring_buf);
+    size_t total = ringBytes + static_cast<size_t>(kBufRingEntries) * kBufSize;
+    void *mem = ::mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED)
+    {
+        LOG_ERROR("IoUringPoller mmap buffer ring error:%d\n", errno);
+        return false;
+    }
+
+    struct io_uring_buf_reg reg;
+    ::memset(&reg, 0, sizeof reg);
+    reg.ring_addr = reinterpret_cast<uint64_t>(mem);
+    reg.ring_entries = kBufRingEntries;
+    reg.bgid = kBufGroup;
+    int ret = ring_.registerOp(IORING_REGISTER_PBUF_RING, &reg, 1);
+    if (ret < 0)
+    {
+        LOG_ERROR("IoUringPoller register buffer ring error:%d\n", errno);
+        ::munmap(mem, total);
+        return false;
+    }
+
+    bufRing_ = static_cast<struct io_uring_buf_ring *>(mem);
+    bufRingSize_ = total;
+    bufBase_ = static_cast<char *>(mem) + ringBytes;
+    bufTail_ = 0;
+    for (unsigned bid = 0; bid < kBufRingEntries; ++bid)
+    {
+        recycleBuffer(static_cast<uint16_t>(bid));
+    }
+    __atomic_store_n(&bufRing_->tail, bufTail_, __ATOMIC_RELEASE);
+    return true;
+}
+
+void IoUringPoller::recycleBuffer(uint16_t bid)
+{
+    // C++下头文件中bufs柔性数组的偏移不为0，直接按io_uring_buf数组访问ring内存
+    struct io_uring_buf *buf = reinterpret_cast<struct io_uring_buf *>(bufRing_) + (bufTail_ & (kBufRingEntries - 1));
+    buf->addr = reinterpret_cast<uint64_t>(bufBase_ + static_cast<size_t>(bid) * kBufSize);
+    buf->len = kBufSize;
+    buf->bid = bid;
+    ++bufTail_;
+}
+
+struct io_uring_sqe *IoUringPoller::newCompletionSqe(uint64_t *id, CompletionCallback cb)
+{
+    struct io_uring_sqe *sqe = ring_.getSqe();
+    if (sqe == nullptr)
+    {
+        LOG_ERROR("IoUringPoller submission queue full\n");
+        *id = 0;
+        return nullptr;
+    }
+    *id = nextCompletionId_;
+    nextCompletionId_ += 2;
+    completions_[*id] = std::make_shared<CompletionCallback>(std::move(cb));
+    sqe->user_data = *id;
+    return sqe;
+}
+
+uint64_t IoUringPoller::submitRecv(int fd, CompletionCallback cb)
+{
+    uint64_t id;
+    struct io_uring_sqe *sqe = newCompletionSqe(&id, std::move(cb));
+    if (sqe != nullptr)
+    {
+        // 每收到一段数据产生一个完成事件，数据放在内核从buffer ring中选出的缓冲区里
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = fd;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = kBufGroup;
+    }
+    return id;
+}
+
+uint64_t IoUringPoller::submitSend(int fd, const struct msghdr *msg, CompletionCallback cb)
+{
+    uint64_t id;
+    struct io_uring_sqe *sqe = newCompletionSqe(&id, std::move(cb));
+    if (sqe != nullptr)
+    {
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uint64_t>(msg);
+        sqe->len = 1;
+        sqe->msg_flags = MSG_NOSIGNAL;
+    }
+    return id;
+}
+
+uint64_t IoUringPoller::submitAccept(int fd, CompletionCallback cb)
+{
+    uint64_t id;
+    struct io_uring_sqe *sqe = newCompletionSqe(&id, std::move(cb));
+    if (sqe != nullptr)
+    {
+        // 每接受一个连接产生一个完成事件，res为新连接的fd
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->fd = fd;
+        sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+        sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    }
+    return id;
+}
+
+void IoUringPoller::cancel(uint64_t id)
+{
+    if (completions_.erase(id) == 0)
+    {
+        return; // 请求已经结束
+    }
+    struct io_uring_sqe *sqe = ring_.getSqe();
+    if (sqe != nullptr)
+    {
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->addr = id;
+        sqe->user_data = kCancelUserData;
+    }
+}
+
+void IoUringPoller::dispatchCompletion(uint64_t id, int res, uint32_t flags, Timestamp receiveTime)
+{
+    bool more = (flags & IORING_CQE_F_MORE) != 0;
+    bool hasBuffer = (flags & IORING_CQE_F_BUFFER) != 0;
+    uint16_t bid = 0;
+    const char *data = nullptr;
+    if (hasBuffer)
+    {
+        bid = static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+        data = bufBase_ + static_cast<size_t>(bid) * kBufSize;
+    }
+
+    auto it = completions_.find(id);
+    if (it != completions_.end())
+    {
+        // 回调中可能cancel自己，先持有一份
+        std::shared_ptr<CompletionCallback> cb(it->second);
+        if (!more)
+        {
+            completions_.erase(it);
+        }
+        (*cb)(res, data, more, receiveTime);
+    }
+
+    // 回调已经处理完数据，缓冲区还给内核；请求已经取消时同样要放回
+    if (hasBuffer)
+    {
+        recycleBuffer(bid);
+    }
+}
+
+Timestamp IoUringPoller::poll(int timeoutMs, ChannalList *activeChannals)
+{
+    if (timeoutMs != 0)
+    {
+        LOG_INFO("func=%s => fd total count:%lu\n", __FUNCTION__, numChannals());
+    }
+
+    // 关注事件的变化和等待合并为一次io_uring_enter
+    flushChanges();
+    int ret = ring_.submitAndWait(timeoutMs);
+    int saveErrno = errno;
+    Timestamp now(Timestamp::now());
+    if (ret < 0 && saveErrno != ETIME && saveErrno != EINTR && saveErrno != EBUSY)
+    {
+        errno = saveErrno;
+        LOG_ERROR("IoUringPoller::poll() err:%d\n", saveErrno);
+    }
+
+    int numEvents = 0;
+    struct io_uring_cqe *cqe;
+    while ((cqe = ring_.peekCqe()) != nullptr)
+    {
+        uint64_t userData = cqe->user_data;
+        int res = cqe->res;
+        uint32_t flags = cqe->flags;
+        ring_.cqeSeen();
+        if (userData == kCancelUserData)
+        {
+            continue;
+        }
+        if ((userData & 1) == 0)
+        {
+            Completion completion = {userData, res, flags};
+            completed_.push_back(completion);
+            continue;
+        }
+
+        int fd = static_cast<int>((userData & 0xffffffff) >> 1);
+        uint32_t generation = static_cast<uint32_t>(userData >> 32);
+        PollState *found = findState(fd);
+        if (found == nullptr || found->generation != generation || found->armedEvents == 0)
+        {
+            continue; // 已经取消或者被新的请求替换
+        }
+
+        PollState &state = *found;
+        state.armedEvents = 0; // 一次性请求已经结束
+        if (res < 0)
+        {
+            // 请求本身失败(如fd已经关闭)，不再自动挂上，等channal下一次update
+            LOG_ERROR("IoUringPoller poll fd=%d err:%d\n", fd, -res);
+            continue;
+        }
+
+        // poll的事件位与epoll相同
+        state.channal->set_revents(res);
+        activeChannals->push_back(state.channal);
+        ++numEvents;
+        // 处理完事件后在下一次poll时重新挂上
+        markDirty(fd, state);
+    }
+
+    // 完成事件在取空完成队列之后回调，回调中提交的新请求在下一次poll时进入内核
+    if (!completed_.empty())
+    {
+        uint16_t oldTail = bufTail_;
+        for (const Completion &completion : completed_)
+        {
+            dispatchCompletion(completion.id, completion.res, completion.flags, now);
+        }
+        numEvents += static_cast<int>(completed_.size());
+        completed_.clear();
+        if (bufRing_ != nullptr && bufTail_ != oldTail)
+        {
+            __atomic_store_n(&bufRing_->tail, bufTail_, __ATOMIC_RELEASE);
+        }
+    }
+
+    if (numEvents > 0)
+    {
+        LOG_INFO("%d events happened\n", numEvents);
+    }
+    return now;
+}
+
+void IoUringPoller::updateChannal(Channal *channal)
+{
+    int fd = channal->fd();
+    LOG_INFO("func=%s => fd=%d events=%d index=%d \n", __FUNCTION__, fd, channal->events(), channal->index());
+
+    size_t index = static_cast<size_t>(fd);
+    if (index >= states_.size())
+    {
+        PollState empty;
+        empty.channal = nullptr;
+        empty.armedEvents = 0;
+        empty.generation = 0;
+        empty.dirty = false;
+        states_.resize(std::max(index + 1, states_.size() * 2), empty);
+    }
+    PollState &state = states_[index];
+    if (state.channal == nullptr)
+    {
+        setChannal(fd, channal);
+    }
+    state.channal = channal;
+    channal->set_index(1);
+    markDirty(fd, state);
+}
+
+void IoUringPoller::removeChannal(Channal *channal)
+{
+    int fd = channal->fd();
+    LOG_INFO("func=%s => fd=%d\n", __FUNCTION__, fd);
+
+    clearChannal(fd);
+    PollState *state = findState(fd);
+    if (state != nullptr)
+    {
+        disarm(fd, *state);
+        state->channal = nullptr;
+        state->dirty = false;
+    }
+    channal->set_index(-1);
+}
+
+void IoUringPoller::markDirty(int fd, PollState &state)
+{
+    if (!state.dirty)
+    {
+        state.dirty = true;
+        changes_.push_back(fd);
+    }
+}
+
+void IoUringPoller::flushChanges()
+{
+    // arm失败时会重新加入changes_，先换出来再遍历
+    std::vector<int> changes;
+    changes.swap(changes_);
+    for (int fd : changes)
+    {
+        PollState *found = findState(fd);
+        if (found == nullptr)
+        {
+            continue; // 已经remove
+        }
+        PollState &state = *found;
+        state.dirty = false;
+
+        uint32_t wanted = static_cast<uint32_t>(state.channal->events());
+        if (state.armedEvents == wanted)
+        {
+            continue;
+        }
+        if (state.armedEvents != 0)
+        {
+            disarm(fd, state);
+        }
+        if (wanted != 0)
+        {
+            arm(fd, state);
+        }
+    }
+}
+
+void IoUringPoller::arm(int fd, PollState &state)
+{
+    struct io_uring_sqe *sqe = ring_.getSqe();
+    if (sqe == nullptr)
+    {
+        LOG_ERROR("IoUringPoller submission queue full, fd=%d\n", fd);
+        markDirty(fd, state);
+        return;
+    }
+    state.generation = nextGeneration_++;
+    if (nextGeneration_ == 0)
+    {
+        nextGeneration_ = 1;
+    }
+    state.armedEvents = static_cast<uint32_t>(state.channal->events());
+
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = state.armedEvents | POLLERR | POLLHUP;
+    sqe->user_data = makeUserData(fd, state.generation);
+}
+
+void IoUringPoller::disarm(int fd, PollState &state)
+{
+    if (state.armedEvents == 0)
+    {
+        return;
+    }
+    struct io_uring_sqe *sqe = ring_.getSqe();
+    if (sqe != nullptr)
+    {
+        sqe->opcode = IORING_OP_POLL_REMOVE;
+        sqe->fd = -1;
+        sqe->addr = makeUserData(fd, state.generation);
+        sqe->user_data = kCancelUserData;
+    }
+    // 被取消请求的完成事件到达时armedEvents为0或generation已经变化，直接丢弃
+    state.armedEvents = 0;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "Poller.h"
+#include "Timestamp.h"
+#include "IoUring.h"
+
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <memory>
+#include <stdint.h>
+
+struct msghdr;
+
+/*
+ * 基于io_uring的Poller
+ * 每个关注事件的fd挂一个IORING_OP_POLL_ADD请求，channal关注事件的变化不立即提交，
+ * 记录下来在下一次poll时与等待一起通过一次io_uring_enter提交
+ * 使用一次性的poll请求，事件返回后在下一次poll时重新挂上：挂上时fd已经就绪会立即完成，
+ * 因此与EpollPoller一样是水平触发，上层不需要一次读空socket
+ *
+ * 除了就绪通知，还提供完成模式：直接提交recv/sendmsg/accept请求，完成事件在poll中回调
+ * 多次触发的recv从loop共享的provided buffer ring中取缓冲区，所有连接共用一块接收内存
+ */
+class IoUringPoller : public Poller
+{
+public:
+    explicit IoUringPoller(EventLoop *loop);
+    ~IoUringPoller() override;
+
+    // io_uring是否初始化成功，失败时newDefaultPoller退回EpollPoller
+    bool valid() const { return ring_.valid(); }
+
+    Timestamp poll(int timeoutMs, ChannalList *activeChannals) override;
+    void updateChannal(Channal *channal) override;
+    void removeChannal(Channal *channal) override;
+
+    // 完成回调：res为请求的返回值(负数为-errno)，recv时data指向本次收到的数据，只在回调期间有效
+    // more为true表示同一个请求还会产生后续完成事件，为false时请求已经结束
+    using CompletionCallback = std::function<void(int res, const char *data, bool more, Timestamp receiveTime)>;
+
+    // 注册provided buffer ring，完成模式的recv需要；内核不支持时返回false
+    bool enableCompletion();
+    bool completionEnabled() const { return bufRing_ != nullptr; }
+
+    // 提交请求，返回请求id；请求结束(more为false)后自动注销回调
+    // 提交在下一次poll时与等待一起进入内核
+    uint64_t submitRecv(int fd, CompletionCallback cb);                        // 多次触发的recv
+    uint64_t submitSend(int fd, const struct msghdr *msg, CompletionCallback cb); // msg及其中的数据需要保持到完成
+    uint64_t submitAccept(int fd, CompletionCallback cb);                      // 多次触发的accept
+    // 取消请求并立即注销回调，之后到达的完成事件直接丢弃
+    void cancel(uint64_t id);
+
+private:
+    static const unsigned kRingEntries = 1024;
+    // provided buffer ring的缓冲区个数(2的幂)和每个缓冲区的大小
+    static const unsigned kBufRingEntries = 256;
+    static const unsigned kBufSize = 16 * 1024;
+    static const uint16_t kBufGroup = 0;
+
+    // 每个fd上poll请求的状态，channal为nullptr表示该fd没有注册
+    struct PollState
+    {
+        Channal *channal;
+        uint32_t armedEvents; // 已经挂在内核上的poll请求关注的事件，0表示没有
+        uint32_t generation;  // 每次挂上新请求时递增，用来识别过期的完成事件
+        bool dirty;           // 已经在changes_中等待提交
+    };
+
+    // 把关注事件变化了的fd重新挂上poll请求
+    void flushChanges();
+    void arm(int fd, PollState &state);
+    void disarm(int fd, PollState &state);
+    void markDirty(int fd, PollState &state);
+    PollState *findState(int fd)
+    {
+        return static_cast<size_t>(fd) < states_.size() && states_[fd].channal != nullptr ? &states_[fd] : nullptr;
+    }
+
+    // poll请求的user_data最低位为1，完成模式请求的id为非0偶数
+    static uint64_t makeUserData(int fd, uint32_t generation)
+    {
+        return (static_cast<uint64_t>(generation) << 32) | (static_cast<uint64_t>(fd) << 1) | 1;
+    }
+
+    struct io_uring_sqe *newCompletionSqe(uint64_t *id, CompletionCallback cb);
+    // 执行一个完成事件的回调，并把用到的接收缓冲区放回ring
+    void dispatchCompletion(uint64_t id, int res, uint32_t flags, Timestamp receiveTime);
+    void recycleBuffer(uint16_t bid);
+
+    struct Completion
+    {
+        uint64_t id;
+        int res;
+        uint32_t flags;
+    };
+
+    IoUring ring_;
+    uint32_t nextGeneration_;
+    std::vector<PollState> states_; // 以fd为下标
+    std::vector<int> changes_; // 等待提交的fd
+
+    uint64_t nextCompletionId_;
+    std::unordered_map<uint64_t, std::shared_ptr<CompletionCallback>> completions_;
+    std::vector<Completion> completed_; // 本次poll收到的完成事件，取完完成队列后统一回调
+
+    struct io_uring_buf_ring *bufRing_;
+    size_t bufRingSize_;
+    char *bufBase_;
+    uint16_t bufTail_; // 本地已放回的缓冲区位置，回调结束后一次发布给内核
+};
@@ -0,0 +1,215 @@
+#include "LoopDispatcher.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+#include "Timestamp.h"
+
+#include <algorithm>
+#include <utility>
+#include <stdint.h>
+
+// 64位整数的混合函数(splitmix64的结尾部分)，用于哈希和随机数
+static uint64_t mix64(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+class RoundRobinDispatcher : public LoopDispatcher
+{
+public:
+    RoundRobinDispatcher() : next_(0) {}
+
+    EventLoop *select(const std::vector<EventLoop *> &loops, const InetAddress &) override
+    {
+        if (next_ >= loops.size())
+        {
+            next_ = 0;
+        }
+        return loops[next_++];
+    }
+
+private:
+    size_t next_;
+};
+
+class LeastConnectionsDispatcher : public LoopDispatcher
+{
+public:
+    LeastConnectionsDispatcher() : next_(0) {}
+
+    EventLoop *select(const std::vector<EventLoop *> &loops, const InetAddress &) override
+    {
+        // 从上次之后的位置开始找，连接数相同时轮流分配
+        size_t n = loops.size();
+        size_t start = ++next_ % n;
+        EventLoop *best = loops[start];
+        for (size_t i = 1; i < n; ++i)
+        {
+            EventLoop *loop = loops[(start + i) % n];
+            if (loop->numConnections() < best->numConnections())
+            {
+                best = loop;
+            }
+        }
+        return best;
+    }
+
+private:
+    size_t next_;
+};
+
+class LeastUtilizationDispatcher : public LoopDispatcher
+{
+public:
+    EventLoop *select(const std::vector<EventLoop *> &loops, const InetAddress &) override
+    {
+        if (samples_.size() != loops.size())
+        {
+            samples_.assign(loops.size(), Sample());
+        }
+        Timestamp now = Timestamp::now();
+        size_t best = 0;
+        for (size_t i = 0; i < loops.size(); ++i)
+        {
+            refresh(loops[i], &samples_[i], now);
+            const Sample &sample = samples_[i];
+            const Sample &bestSample = samples_[best];
+            if (sample.utilization < bestSample.utilization ||
+                (sample.utilization == bestSample.utilization && loops[i]->numConnections() < loops[best]->numConnections()))
+            {
+                best = i;
+            }
+        }
+        return loops[best];
+    }
+
+private:
+    // 每个loop的忙碌比例按kWindowSeconds长的窗口计算，窗口内沿用上一个窗口的值
+    static constexpr double kWindowSeconds = 0.1;
+
+    struct Sample
+    {
+        Timestamp time;
+        uint64_t busyUs = 0;
+        uint64_t totalUs = 0;
+        double utilization = 0.0;
+    };
+
+    static void refresh(EventLoop *loop, Sample *sample, Timestamp now)
+    {
+        if (sample->time.valid() && timeDifference(now, sample->time) < kWindowSeconds)
+        {
+            return;
+        }
+        uint64_t busyUs, totalUs;
+        loop->busyTime(&busyUs, &totalUs);
+        // 加上当前还没有结束的一轮，否则卡在回调中、迟迟完成不了迭代的loop会显得空闲
+        uint64_t unfinishedUs = loop->unfinishedBusyUs();
+        uint64_t busy = busyUs - sample->busyUs + unfinishedUs;
+        uint64_t total = totalUs - sample->totalUs + unfinishedUs;
+        // 仍为0说明窗口内一直阻塞在poll中，确实空闲
+        sample->utilization = total > 0 ? static_cast<double>(busy) / total : 0.0;
+        sample->busyUs = busyUs;
+        sample->totalUs = totalUs;
+        sample->time = now;
+    }
+
+    std::vector<Sample> samples_;
+};
+
+constexpr double LeastUtilizationDispatcher::kWindowSeconds;
+
+class PowerOfTwoChoicesDispatcher : public LoopDispatcher
+{
+public:
+    PowerOfTwoChoicesDispatcher() : state_(static_cast<uint64_t>(Timestamp::now().microSecondsSinceEpoch())) {}
+
+    EventLoop *select(const std::vector<EventLoop *> &loops, const InetAddress &) override
+    {
+        size_t n = loops.size();
+        if (n == 1)
+        {
+            return loops[0];
+        }
+        size_t a = random() % n;
+        size_t b = random() % (n - 1);
+        if (b >= a)
+        {
+            ++b; // 保证两次选择不同
+        }
+        return loops[b]->numConnections() < loops[a]->numConnections() ? loops[b] : loops[a];
+    }
+
+private:
+    uint64_t random()
+    {
+        state_ += 0x9e3779b97f4a7c15ULL;
+        return mix64(state_);
+    }
+
+    uint64_t state_;
+};
+
+class ConsistentHashDispatcher : public LoopDispatcher
+{
+public:
+    EventLoop *select(const std::vector<EventLoop *> &loops, const InetAddress &peerAddr) override
+    {
+        if (loops.size() != numLoops_)
+        {
+            buildRing(loops.size());
+        }
+        // 只用ip，同一客户端的不同端口落在同一个loop
+        uint64_t hash = mix64(peerAddr.getSockAddr()->sin_addr.s_addr);
+        auto it = std::lower_bound(ring_.begin(), ring_.end(), std::make_pair(hash, static_cast<size_t>(0)));
+        if (it == ring_.end())
+        {
+            it = ring_.begin();
+        }
+        return loops[it->second];
+    }
+
+private:
+    // 每个loop在环上的虚拟节点数，越多分布越均匀
+    static const int kVirtualNodes = 160;
+
+    // 虚拟节点的位置只取决于loop的序号，loop个数变化时只有约1/n的客户端换到别的loop
+    void buildRing(size_t numLoops)
+    {
+        ring_.clear();
+        for (size_t i = 0; i < numLoops; ++i)
+        {
+            for (int v = 0; v < kVirtualNodes; ++v)
+            {
+                ring_.push_back(std::make_pair(mix64((static_cast<uint64_t>(i) << 32) | v), i));
+            }
+        }
+        std::sort(ring_.begin(), ring_.end());
+        numLoops_ = numLoops;
+    }
+
+    std::vector<std::pair<uint64_t, size_t>> ring_; // (哈希值, loop序号)
+    size_t numLoops_ = 0;
+};
+
+LoopDispatcher *LoopDispatcher::newDispatcher(Policy policy)
+{
+    switch (policy)
+    {
+    case kLeastConnections:
+        return new LeastConnectionsDispatcher;
+    case kLeastUtilization:
+        return new LeastUtilizationDispatcher;
+    case kPowerOfTwoChoices:
+        return new PowerOfTwoChoicesDispatcher;
+    case kConsistentHash:
+        return new ConsistentHashDispatcher;
+    case kRoundRobin:
+    default:
+        return new RoundRobinDispatcher;
+    }
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <vector>
+
+class EventLoop;
+class InetAddress;
+
+// 为新连接选择subloop的策略，由EventLoopThreadPool在baseloop线程中调用
+class LoopDispatcher : noncopyable
+{
+public:
+    enum Policy
+    {
+        kRoundRobin,         // 轮询
+        kLeastConnections,   // 连接数最少的loop
+        kLeastUtilization,   // 最近一段时间忙碌比例最低的loop
+        kPowerOfTwoChoices,  // 随机选两个loop，取连接数少的
+        kConsistentHash,     // 按对端ip一致性哈希，同一客户端的连接落在同一个loop
+    };
+
+    virtual ~LoopDispatcher() = default;
+
+    // loops非空
+    virtual EventLoop *select(const std::vector<EventLoop *> &loops, const InetAddress &peerAddr) = 0;
+
+    static LoopDispatcher *newDispatcher(Policy policy);
+};
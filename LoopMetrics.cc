@@ -0,0 +1,47 @@
+#include "LoopMetrics.h"
+
+#include <stdio.h>
+
+LoopMetrics::LoopMetrics()
+    : wakeups_(0),
+      functors_(0),
+      busyUs_(0),
+      totalUs_(0),
+      busySinceUs_(0)
+{
+}
+
+LoopMetrics::Snapshot LoopMetrics::snapshot() const
+{
+    Snapshot snap;
+    snap.iterationUs = iterationUs_.snapshot();
+    snap.pollWaitUs = pollWaitUs_.snapshot();
+    snap.eventsPerPoll = eventsPerPoll_.snapshot();
+    snap.handleEventUs = handleEventUs_.snapshot();
+    snap.pendingFunctorUs = pendingFunctorUs_.snapshot();
+    snap.queueDepth = queueDepth_.snapshot();
+    snap.queueWaitUs = queueWaitUs_.snapshot();
+    snap.wakeups = wakeups_.load(std::memory_order_relaxed);
+    snap.functors = functors_.load(std::memory_order_relaxed);
+    busyTime(&snap.busyUs, &snap.totalUs);
+    return snap;
+}
+
+std::string LoopMetrics::Snapshot::toString() const
+{
+    char buf[128];
+    snprintf(buf, sizeof buf, "wakeups=%lu functors=%lu utilization=%.3f\n",
+             static_cast<unsigned long>(wakeups), static_cast<unsigned long>(functors),
+             totalUs > 0 ? static_cast<double>(busyUs) / totalUs : 0.0);
+
+    std::string result;
+    result += "iterationUs      " + iterationUs.toString() + "\n";
+    result += "pollWaitUs       " + pollWaitUs.toString() + "\n";
+    result += "eventsPerPoll    " + eventsPerPoll.toString() + "\n";
+    result += "handleEventUs    " + handleEventUs.toString() + "\n";
+    result += "pendingFunctorUs " + pendingFunctorUs.toString() + "\n";
+    result += "queueDepth       " + queueDepth.toString() + "\n";
+    result += "queueWaitUs      " + queueWaitUs.toString() + "\n";
+    result += buf;
+    return result;
+}
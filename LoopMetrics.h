@@ -0,0 +1,109 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Histogram.h"
+#include "Timestamp.h"
+
+#include <atomic>
+#include <string>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * 单个EventLoop的运行统计，由loop线程记录，其它线程通过snapshot无锁读取
+ * 时间的单位都是微秒
+ */
+class LoopMetrics : noncopyable
+{
+public:
+    struct Snapshot
+    {
+        Histogram::Snapshot iterationUs;      // 一轮循环的总耗时
+        Histogram::Snapshot pollWaitUs;       // 阻塞在poll中的时间(忙轮询时包括轮询)
+        Histogram::Snapshot eventsPerPoll;    // 每次poll返回的事件数
+        Histogram::Snapshot handleEventUs;    // 每轮中Channal::handleEvent的总耗时
+        Histogram::Snapshot pendingFunctorUs; // 每轮中doPendingFunctor的耗时
+        Histogram::Snapshot queueDepth;       // 开始执行回调时队列中的回调个数
+        Histogram::Snapshot queueWaitUs;      // 每批回调中最早入队的回调等待执行的时间
+        uint64_t wakeups;                     // 写wakeupfd唤醒loop的次数
+        uint64_t functors;                    // 执行的回调个数
+        uint64_t busyUs;                      // 累计的非poll等待时间
+        uint64_t totalUs;                     // 累计的循环时间
+
+        // 多行文本，便于打日志
+        std::string toString() const;
+    };
+
+    LoopMetrics();
+
+    // 以下由loop线程调用
+    // poll返回，开始处理本轮的事件和回调
+    void recordPollReturn(Timestamp pollReturn) { busySinceUs_.store(pollReturn.microSecondsSinceEpoch(), std::memory_order_relaxed); }
+    // 一轮循环结束：start本轮开始，pollReturn poll返回，eventsHandled处理完io事件，end执行完回调
+    void recordIteration(Timestamp start, Timestamp pollReturn, Timestamp eventsHandled, Timestamp end, size_t numEvents)
+    {
+        uint64_t iterationUs = elapsed(start, end);
+        uint64_t pollWaitUs = elapsed(start, pollReturn);
+        iterationUs_.record(iterationUs);
+        pollWaitUs_.record(pollWaitUs);
+        add(totalUs_, iterationUs);
+        add(busyUs_, iterationUs > pollWaitUs ? iterationUs - pollWaitUs : 0);
+        eventsPerPoll_.record(numEvents);
+        handleEventUs_.record(elapsed(pollReturn, eventsHandled));
+        pendingFunctorUs_.record(elapsed(eventsHandled, end));
+        busySinceUs_.store(0, std::memory_order_relaxed);
+    }
+    // 开始执行一批回调，waitUs<0表示不知道入队时间
+    void recordPendingFunctors(size_t depth, int64_t waitUs)
+    {
+        queueDepth_.record(depth);
+        if (waitUs >= 0)
+        {
+            queueWaitUs_.record(static_cast<uint64_t>(waitUs));
+        }
+        add(functors_, depth);
+    }
+
+    // 任意线程调用
+    void recordWakeup() { wakeups_.fetch_add(1, std::memory_order_relaxed); }
+
+    Snapshot snapshot() const;
+
+    // 累计的忙碌时间和循环时间，两次读取之差可以算出这段时间的忙碌比例
+    void busyTime(uint64_t *busyUs, uint64_t *totalUs) const
+    {
+        *busyUs = busyUs_.load(std::memory_order_relaxed);
+        *totalUs = totalUs_.load(std::memory_order_relaxed);
+    }
+    // 当前这一轮已经忙碌了多久(还没有计入busyTime)，在poll中等待时为0
+    uint64_t unfinishedBusyUs(Timestamp now) const
+    {
+        int64_t since = busySinceUs_.load(std::memory_order_relaxed);
+        return since > 0 ? elapsed(Timestamp(since), now) : 0;
+    }
+
+private:
+    static uint64_t elapsed(Timestamp from, Timestamp to)
+    {
+        int64_t diff = to.microSecondsSinceEpoch() - from.microSecondsSinceEpoch();
+        return diff > 0 ? static_cast<uint64_t>(diff) : 0; // 系统时间被回拨时记为0
+    }
+    // 单写者的计数器
+    static void add(std::atomic<uint64_t> &counter, uint64_t n)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    Histogram iterationUs_;
+    Histogram pollWaitUs_;
+    Histogram eventsPerPoll_;
+    Histogram handleEventUs_;
+    Histogram pendingFunctorUs_;
+    Histogram queueDepth_;
+    Histogram queueWaitUs_;
+    std::atomic<uint64_t> wakeups_;
+    std::atomic<uint64_t> functors_;
+    std::atomic<uint64_t> busyUs_;
+    std::atomic<uint64_t> totalUs_;
+    std::atomic<int64_t> busySinceUs_; // 本轮poll返回的时间，0表示在poll中等待
+};
@@ -0,0 +1,148 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+/*
+ * 无锁的多生产者单消费者队列：预先分配的环形数组(Vyukov bounded queue)，槽位循环复用，入队出队不申请内存
+ * 每个槽位带一个序号：等于pos时可以写入，等于pos+1时已经写好可以取出，取出后加上容量留给下一圈
+ * 生产者CAS抢到写入位置、写入元素、store序号，不加锁；只有一个消费者线程调用pop
+ * 生产者抢到位置之后、store序号之前，消费者会暂时看不到这个元素，pop返回false，
+ * 调用者需要保证之后还会再pop一次(EventLoop中由生产者随后的wakeup保证)
+ *
+ * 环满时元素进入加锁的溢出队列，push返回true；溢出队列非空期间所有生产者都写入溢出队列，
+ * 消费者取空环之后才取溢出队列，同一生产者的元素保持入队顺序
+ */
+template <typename T>
+class MpscQueue : noncopyable
+{
+public:
+    static const size_t kDefaultCapacity = 1024;
+
+    // capacity需要是2的幂
+    explicit MpscQueue(size_t capacity = kDefaultCapacity)
+        : mask_(capacity - 1),
+          cells_(new Cell[capacity]),
+          enqueuePos_(0),
+          dequeuePos_(0),
+          overflowing_(false),
+          size_(0)
+    {
+        for (size_t i = 0; i < capacity; ++i)
+        {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // 任意线程调用，返回元素是否进入了溢出队列(会申请内存)
+    bool push(T &&value)
+    {
+        bool spilled = overflowing_.load(std::memory_order_acquire) || !pushRing(value);
+        if (spilled)
+        {
+            std::lock_guard<std::mutex> lock(overflowMutex_);
+            overflow_.push_back(std::move(value));
+            overflowing_.store(true, std::memory_order_release);
+        }
+        size_.fetch_add(1, std::memory_order_release);
+        return spilled;
+    }
+
+    // 只能在消费者线程调用，队列为空(或队首元素尚未写好)时返回false
+    bool pop(T &value)
+    {
+        Cell &cell = cells_[dequeuePos_ & mask_];
+        if (cell.sequence.load(std::memory_order_acquire) == dequeuePos_ + 1)
+        {
+            value = std::move(cell.value);
+            cell.sequence.store(dequeuePos_ + mask_ + 1, std::memory_order_release);
+            ++dequeuePos_;
+        }
+        else if (enqueuePos_.load(std::memory_order_relaxed) != dequeuePos_ ||
+                 !overflowing_.load(std::memory_order_acquire) || !popOverflow(value))
+        {
+            // 环中还有已占位但未写好的元素时不取溢出队列，否则同一生产者先入环的元素会排到后面
+            return false;
+        }
+        size_.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // 已经完整入队的元素个数，只是近似值
+    size_t size() const { return size_.load(std::memory_order_acquire); }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    bool pushRing(T &value)
+    {
+        size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+        Cell *cell;
+        for (;;)
+        {
+            cell = &cells_[pos & mask_];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (diff == 0)
+            {
+                if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false; // 环满，这一圈的槽位还没有被消费者取走
+            }
+            else
+            {
+                pos = enqueuePos_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = std::move(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool popOverflow(T &value)
+    {
+        std::lock_guard<std::mutex> lock(overflowMutex_);
+        if (overflow_.empty())
+        {
+            return false;
+        }
+        value = std::move(overflow_.front());
+        overflow_.pop_front();
+        if (overflow_.empty())
+        {
+            // 之后的生产者重新写入环中
+            overflowing_.store(false, std::memory_order_release);
+        }
+        return true;
+    }
+
+    const size_t mask_;
+    std::unique_ptr<Cell[]> cells_;
+    char pad0_[64];
+    std::atomic<size_t> enqueuePos_; // 生产者竞争的写入位置
+    char pad1_[64];
+    size_t dequeuePos_;              // 只有消费者访问
+    char pad2_[64];
+    std::atomic<bool> overflowing_;
+    std::mutex overflowMutex_;
+    std::deque<T> overflow_;
+    std::atomic<size_t> size_;
+};
+
+template <typename T>
+const size_t MpscQueue<T>::kDefaultCapacity;
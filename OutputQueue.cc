@@ -0,0 +1,488 @@
+#include "OutputQueue.h"
+#include "Logger.h"
+
+#include <sys/uio.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <linux/errqueue.h>
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY 5
+#endif
+#ifndef SO_EE_CODE_ZEROCOPY_COPIED
+#define SO_EE_CODE_ZEROCOPY_COPIED 1
+#endif
+
+const size_t OutputQueue::kCoalesceLimit;
+const size_t OutputQueue::kDefaultZeroCopyThreshold;
+
+// 单次sendfile的最大长度，避免一个大文件长时间占住loop
+const size_t kMaxSendfileChunk = 1024 * 1024;
+
+OutputQueue::FileRegion &OutputQueue::FileRegion::operator=(FileRegion &&rhs)
+{
+    if (this != &rhs)
+    {
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+        fd = rhs.fd;
+        offset = rhs.offset;
+        len = rhs.len;
+        rhs.fd = -1;
+    }
+    return *this;
+}
+
+OutputQueue::FileRegion::~FileRegion()
+{
+    if (fd >= 0)
+    {
+        ::close(fd);
+    }
+}
+
+size_t OutputQueue::Segment::readableBytes() const
+{
+    switch (type)
+    {
+    case kBuffer:
+        return buffer->readableBytes();
+    case kString:
+        return str.size() - offset;
+    case kSlice:
+        return slice.size();
+    case kFile:
+        return file.len;
+    }
+    return 0;
+}
+
+OutputQueue::OutputQueue(BufferPool *pool)
+    : pool_(pool),
+      readable_(0),
+      fileBytes_(0),
+      tailSealed_(false),
+      zeroCopyThreshold_(0),
+      zeroCopySeq_(0),
+      zeroCopySends_(0),
+      zeroCopyCompletions_(0),
+      zeroCopyCopied_(0)
+{
+}
+
+OutputQueue::~OutputQueue()
+{
+    if (!zeroCopyPending_.empty())
+    {
+        // 内核可能仍在发送这些内存，释放后被复用会让对端收到错误的数据，宁可泄漏
+        // 正常情况下TcpConnection会等完成通知全部到达后才销毁，只有loop退出时才会走到这里
+        LOG_ERROR("OutputQueue::~OutputQueue %lu zero-copy sends not completed, leaking their data\n",
+                  static_cast<unsigned long>(zeroCopyPending_.size()));
+        new std::deque<ZeroCopyPending>(std::move(zeroCopyPending_));
+    }
+}
+
+Buffer *OutputQueue::tailBuffer()
+{
+    if (segments_.empty() || segments_.back().type != kBuffer || tailSealed_)
+    {
+        tailSealed_ = false;
+        Segment seg(kBuffer);
+        if (spareBuffer_)
+        {
+            seg.buffer = std::move(spareBuffer_);
+        }
+        else
+        {
+            seg.buffer.reset(new Buffer(Buffer::kChained, pool_));
+        }
+        segments_.push_back(std::move(seg));
+    }
+    return segments_.back().buffer.get();
+}
+
+void OutputQueue::append(const char *data, size_t len)
+{
+    if (len == 0)
+    {
+        return;
+    }
+    tailBuffer()->append(data, len);
+    readable_ += len;
+}
+
+void OutputQueue::append(std::string &&str)
+{
+    if (str.size() < kCoalesceLimit)
+    {
+        append(str.data(), str.size());
+        return;
+    }
+    Segment seg(kString);
+    seg.str.swap(str);
+    readable_ += seg.str.size();
+    segments_.push_back(std::move(seg));
+}
+
+void OutputQueue::append(const Slice &slice)
+{
+    if (slice.size() < kCoalesceLimit)
+    {
+        append(slice.data(), slice.size());
+        return;
+    }
+    Segment seg(kSlice);
+    seg.slice = slice;
+    readable_ += slice.size();
+    segments_.push_back(std::move(seg));
+}
+
+void OutputQueue::append(Buffer &&buf)
+{
+    size_t len = buf.readableBytes();
+    if (len == 0)
+    {
+        return;
+    }
+    if (len < kCoalesceLimit)
+    {
+        // 小数据拷贝过去，buf的内存留给调用者继续使用
+        Buffer *tail = tailBuffer();
+        while (buf.readableBytes() > 0)
+        {
+            size_t n = buf.contiguousReadableBytes();
+            tail->append(buf.peek(), n);
+            buf.retrieve(n);
+        }
+        readable_ += len;
+        return;
+    }
+    Segment seg(kBuffer);
+    seg.buffer.reset(new Buffer(std::move(buf)));
+    readable_ += len;
+    segments_.push_back(std::move(seg));
+}
+
+void OutputQueue::appendFile(int fd, off_t offset, size_t len)
+{
+    if (len == 0)
+    {
+        ::close(fd);
+        return;
+    }
+    Segment seg(kFile);
+    seg.file.fd = fd;
+    seg.file.offset = offset;
+    seg.file.len = len;
+    fileBytes_ += len;
+    segments_.push_back(std::move(seg));
+}
+
+void OutputQueue::retrieve(size_t len)
+{
+    while (len > 0 && !segments_.empty())
+    {
+        Segment &front = segments_.front();
+        size_t readable = front.readableBytes();
+        size_t n = std::min(len, readable);
+        if (front.type == kFile)
+        {
+            fileBytes_ -= n;
+        }
+        else
+        {
+            readable_ -= n;
+        }
+        switch (front.type)
+        {
+        case kBuffer:
+            front.buffer->retrieve(n);
+            break;
+        case kString:
+            front.offset += n;
+            break;
+        case kSlice:
+            front.slice.removePrefix(n);
+            break;
+        case kFile:
+            front.file.offset += n;
+            front.file.len -= n;
+            break;
+        }
+        len -= n;
+
+        if (n == readable)
+        {
+            if (front.type == kBuffer && !spareBuffer_ && front.buffer->mode() == Buffer::kChained)
+            {
+                spareBuffer_ = std::move(front.buffer);
+            }
+            segments_.pop_front();
+        }
+    }
+}
+
+void OutputQueue::splice(OutputQueue &other)
+{
+    for (Segment &seg : other.segments_)
+    {
+        segments_.push_back(std::move(seg));
+    }
+    readable_ += other.readable_;
+    fileBytes_ += other.fileBytes_;
+    other.segments_.clear();
+    other.readable_ = 0;
+    other.fileBytes_ = 0;
+}
+
+void OutputQueue::retrieveAll()
+{
+    segments_.clear();
+    readable_ = 0;
+    fileBytes_ = 0;
+}
+
+int OutputQueue::fillIovecs(struct iovec *vec, int maxIovecs, size_t *bytes) const
+{
+    int iovcnt = 0;
+    for (size_t i = 0; i < segments_.size() && iovcnt < maxIovecs; ++i)
+    {
+        const Segment &seg = segments_[i];
+        if (seg.type == kFile || useZeroCopy(seg))
+        {
+            break; // 文件段、零拷贝段之前的数据先发完，保持顺序
+        }
+        switch (seg.type)
+        {
+        case kBuffer:
+            iovcnt += seg.buffer->fillIovecs(vec + iovcnt, maxIovecs - iovcnt);
+            break;
+        case kString:
+            vec[iovcnt].iov_base = const_cast<char *>(seg.str.data() + seg.offset);
+            vec[iovcnt].iov_len = seg.str.size() - seg.offset;
+            ++iovcnt;
+            break;
+        case kSlice:
+            vec[iovcnt].iov_base = const_cast<char *>(seg.slice.data());
+            vec[iovcnt].iov_len = seg.slice.size();
+            ++iovcnt;
+            break;
+        case kFile:
+            break;
+        }
+    }
+
+    *bytes = 0;
+    for (int i = 0; i < iovcnt; ++i)
+    {
+        *bytes += vec[i].iov_len;
+    }
+    return iovcnt;
+}
+
+// 队首的文件段通过sendfile发送，complete表示本次请求的长度全部发出
+ssize_t OutputQueue::sendFileSegment(int fd, int *savedErrno, bool *complete)
+{
+    FileRegion &file = segments_.front().file;
+    size_t count = std::min(file.len, kMaxSendfileChunk);
+    ssize_t n = ::sendfile(fd, file.fd, &file.offset, count);
+    if (n < 0)
+    {
+        *savedErrno = errno;
+        return n;
+    }
+    if (n == 0)
+    {
+        // 文件比请求的区间短(被截断)，丢弃剩余部分，避免一直重试
+        LOG_ERROR("OutputQueue::sendFileSegment file fd=%d ended %lu bytes early\n", file.fd, file.len);
+        fileBytes_ -= file.len;
+        segments_.pop_front();
+        *complete = true;
+        return 0;
+    }
+
+    // sendfile已经推进了file.offset
+    file.len -= n;
+    fileBytes_ -= n;
+    *complete = static_cast<size_t>(n) == count;
+    if (file.len == 0)
+    {
+        segments_.pop_front();
+    }
+    return n;
+}
+
+bool OutputQueue::useZeroCopy(const Segment &seg) const
+{
+    return zeroCopyThreshold_ > 0 &&
+           (seg.type == kString || seg.type == kSlice) &&
+           seg.readableBytes() >= zeroCopyThreshold_;
+}
+
+// 队首的string/slice通过MSG_ZEROCOPY单独发送，发出的部分在收到完成通知前保持引用
+ssize_t OutputQueue::sendZeroCopySegment(int fd, int *savedErrno, bool *complete)
+{
+    Segment &front = segments_.front();
+    if (front.type == kString)
+    {
+        // string转成slice，之后才能与内核共享同一份内存的所有权
+        Slice slice = Slice::fromString(std::move(front.str));
+        slice.removePrefix(front.offset);
+        front.type = kSlice;
+        front.slice = slice;
+        front.offset = 0;
+    }
+
+    struct iovec vec;
+    vec.iov_base = const_cast<char *>(front.slice.data());
+    vec.iov_len = front.slice.size();
+    struct msghdr msg;
+    ::memset(&msg, 0, sizeof msg);
+    msg.msg_iov = &vec;
+    msg.msg_iovlen = 1;
+
+    ssize_t n = ::sendmsg(fd, &msg, MSG_ZEROCOPY);
+    if (n < 0 && errno == ENOBUFS)
+    {
+        // 超过optmem限制，本次退化为普通发送
+        n = ::sendmsg(fd, &msg, 0);
+        if (n >= 0)
+        {
+            retrieve(n);
+            *complete = static_cast<size_t>(n) == vec.iov_len;
+            return n;
+        }
+    }
+    if (n < 0)
+    {
+        *savedErrno = errno;
+        return n;
+    }
+
+    ZeroCopyPending pending;
+    pending.seq = zeroCopySeq_++;
+    pending.holder = front.slice.holder();
+    zeroCopyPending_.push_back(pending);
+    ++zeroCopySends_;
+
+    retrieve(n);
+    *complete = static_cast<size_t>(n) == vec.iov_len;
+    return n;
+}
+
+int OutputQueue::handleZeroCopyCompletions(int fd)
+{
+    int handled = 0;
+    char control[128];
+    for (;;)
+    {
+        struct msghdr msg;
+        ::memset(&msg, 0, sizeof msg);
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof control;
+        if (::recvmsg(fd, &msg, MSG_ERRQUEUE) < 0)
+        {
+            break; // EAGAIN：错误队列已读空
+        }
+
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg))
+        {
+            bool recvErr = (cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) ||
+                           (cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR);
+            if (!recvErr)
+            {
+                continue;
+            }
+            const struct sock_extended_err *serr = reinterpret_cast<const struct sock_extended_err *>(CMSG_DATA(cmsg));
+            if (serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+            {
+                continue;
+            }
+
+            // [ee_info, ee_data] 区间内的发送都已完成，序号会回绕，用差值比较
+            uint32_t hi = serr->ee_data;
+            while (!zeroCopyPending_.empty() &&
+                   static_cast<int32_t>(hi - zeroCopyPending_.front().seq) >= 0)
+            {
+                zeroCopyPending_.pop_front();
+            }
+            zeroCopyCompletions_ += hi - serr->ee_info + 1;
+            if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+            {
+                zeroCopyCopied_ += hi - serr->ee_info + 1;
+            }
+            ++handled;
+        }
+    }
+    return handled;
+}
+
+OutputQueue::ZeroCopyStats OutputQueue::zeroCopyStats() const
+{
+    ZeroCopyStats stats;
+    stats.sends = zeroCopySends_;
+    stats.completions = zeroCopyCompletions_;
+    stats.copied = zeroCopyCopied_;
+    stats.pending = zeroCopyPending_.size();
+    return stats;
+}
+
+// 每次writev最多IOV_MAX个数据段，一次写满说明socket还可写，继续写直到队列为空或者写不完
+ssize_t OutputQueue::writeFd(int fd, int *savedErrno, size_t budget)
+{
+    struct iovec vec[IOV_MAX];
+    size_t total = 0;
+    while (!empty())
+    {
+        ssize_t n = 0;
+        bool complete = false;
+        if (segments_.front().type == kFile)
+        {
+            n = sendFileSegment(fd, savedErrno, &complete);
+        }
+        else if (useZeroCopy(segments_.front()))
+        {
+            n = sendZeroCopySegment(fd, savedErrno, &complete);
+        }
+        else
+        {
+            size_t bytes = 0;
+            int iovcnt = fillIovecs(vec, IOV_MAX, &bytes);
+            n = ::writev(fd, vec, iovcnt);
+            if (n < 0)
+            {
+                *savedErrno = errno;
+            }
+            else
+            {
+                retrieve(n);
+                complete = static_cast<size_t>(n) == bytes;
+            }
+        }
+
+        if (n < 0)
+        {
+            return total > 0 ? static_cast<ssize_t>(total) : n;
+        }
+        total += n;
+        if (!complete)
+        {
+            break; // 内核发送缓冲区已满
+        }
+        if (budget > 0 && total >= budget)
+        {
+            break;
+        }
+    }
+    return static_cast<ssize_t>(total);
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Buffer.h"
+#include "Slice.h"
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <stdint.h>
+#include <sys/types.h>
+
+class BufferPool;
+struct iovec;
+
+/*
+ * TcpConnection的发送队列，由若干数据段组成：
+ *   kBuffer  拷贝进来的小块数据，连续追加的小数据合并到同一个链式Buffer中
+ *   kString  接管所有权的string
+ *   kSlice   引用计数的数据片段
+ *   kFile    文件区间，通过sendfile由内核直接发送，不经过用户态
+ * writeFd把队列中尽可能多的数据段组成iovec，一次writev发出，大块数据不需要拷贝到发送缓冲区
+ * 文件段与前后的内存数据段保持先后顺序
+ *
+ * 开启零拷贝后，不小于阈值的string/slice数据段通过sendmsg(MSG_ZEROCOPY)发送，
+ * 数据的引用保留到内核在socket错误队列上通知发送完成为止，队列析构时仍未完成的数据不会释放
+ */
+class OutputQueue : noncopyable
+{
+public:
+    // 小于该长度的string/slice直接拷贝进Buffer段，减少iovec的个数
+    static const size_t kCoalesceLimit = 1024;
+    static const size_t kDefaultZeroCopyThreshold = 64 * 1024;
+
+    // 零拷贝发送的统计
+    struct ZeroCopyStats
+    {
+        uint64_t sends;       // MSG_ZEROCOPY发送的次数
+        uint64_t completions; // 内核通知完成的次数
+        uint64_t copied;      // 内核退化为拷贝发送的次数(如loopback)
+        size_t pending;       // 等待内核完成通知的数据段个数
+    };
+
+    explicit OutputQueue(BufferPool *pool = nullptr);
+    ~OutputQueue();
+
+    // 待发送的字节数
+    size_t readableBytes() const { return readable_ + fileBytes_; }
+    // 待发送数据中占用内存的部分，不含文件段
+    size_t memoryBytes() const { return readable_; }
+    bool empty() const { return readable_ == 0 && fileBytes_ == 0; }
+    size_t segments() const { return segments_.size(); }
+
+    void append(const char *data, size_t len);
+    void append(std::string &&str);
+    void append(const Slice &slice);
+    void append(Buffer &&buf);
+    // 发送文件fd的[offset, offset+len)区间，接管fd的所有权，发送完或队列销毁时关闭
+    void appendFile(int fd, off_t offset, size_t len);
+
+    // 把other中的全部数据段按顺序移到队尾，other变为空
+    void splice(OutputQueue &other);
+
+    // 去掉队首已经发送的len字节
+    void retrieve(size_t len);
+    void retrieveAll();
+
+    // 把队首连续的内存数据段填入vec，遇到文件段、零拷贝段时停止，返回iovec个数
+    int fillIovecs(struct iovec *vec, int maxIovecs, size_t *bytes) const;
+    // 异步发送期间vec引用的数据不能移动：seal之后新追加的小数据进入新的Buffer段
+    void sealTail() { tailSealed_ = true; }
+
+    // 把队列组成iovec通过writev发送，已发送的数据会从队列中取走，返回发送的字节数
+    // budget不为0时发送超过budget字节后停止，即使socket仍然可写
+    ssize_t writeFd(int fd, int *savedErrno, size_t budget = 0);
+
+    // 不小于threshold的数据段使用MSG_ZEROCOPY发送，0表示关闭；socket需要先设置SO_ZEROCOPY
+    void setZeroCopyThreshold(size_t threshold) { zeroCopyThreshold_ = threshold; }
+    size_t zeroCopyThreshold() const { return zeroCopyThreshold_; }
+    // 读取fd错误队列中的零拷贝完成通知，释放对应的数据，返回处理的通知个数
+    int handleZeroCopyCompletions(int fd);
+    ZeroCopyStats zeroCopyStats() const;
+
+private:
+    enum SegmentType
+    {
+        kBuffer,
+        kString,
+        kSlice,
+        kFile
+    };
+
+    // 文件段，持有fd的所有权
+    struct FileRegion
+    {
+        int fd;
+        off_t offset;
+        size_t len;
+
+        FileRegion()
+            : fd(-1), offset(0), len(0)
+        {
+        }
+        FileRegion(FileRegion &&rhs)
+            : fd(rhs.fd), offset(rhs.offset), len(rhs.len)
+        {
+            rhs.fd = -1;
+        }
+        FileRegion &operator=(FileRegion &&rhs);
+        ~FileRegion();
+    };
+
+    struct Segment
+    {
+        SegmentType type;
+        std::unique_ptr<Buffer> buffer;
+        std::string str;
+        size_t offset; // str中已经发送的长度
+        Slice slice;
+        FileRegion file;
+
+        explicit Segment(SegmentType t)
+            : type(t), offset(0)
+        {
+        }
+
+        size_t readableBytes() const;
+    };
+
+    // 取得队尾可以追加数据的Buffer段
+    Buffer *tailBuffer();
+    ssize_t sendFileSegment(int fd, int *savedErrno, bool *complete);
+    ssize_t sendZeroCopySegment(int fd, int *savedErrno, bool *complete);
+    bool useZeroCopy(const Segment &seg) const;
+
+    // 已经通过MSG_ZEROCOPY发出、等待内核完成通知的数据
+    struct ZeroCopyPending
+    {
+        uint32_t seq;
+        std::shared_ptr<const void> holder;
+    };
+
+    BufferPool *pool_;
+    size_t readable_;  // 内存数据段的字节数
+    size_t fileBytes_; // 文件段的字节数
+    std::deque<Segment> segments_;
+    std::unique_ptr<Buffer> spareBuffer_; // 复用已发送完的Buffer对象
+    bool tailSealed_;                     // 队尾的Buffer段不能再追加
+
+    size_t zeroCopyThreshold_;
+    uint32_t zeroCopySeq_; // 下一次MSG_ZEROCOPY发送对应的通知序号，与内核的计数保持一致
+    std::deque<ZeroCopyPending> zeroCopyPending_;
+    uint64_t zeroCopySends_;
+    uint64_t zeroCopyCompletions_;
+    uint64_t zeroCopyCopied_;
+};
@@ -1,8 +1,15 @@
 #include "Poller.h"
 #include "Channal.h"
 
+#include <algorithm>
+
+// channal表的初始大小
+const size_t kInitChannalTableSize = 64;
+
 Poller::Poller(EventLoop *loop)
-    : ownerLoop_(loop)
+    : channals_(kInitChannalTableSize, nullptr),
+      numChannals_(0),
+      ownerLoop_(loop)
 {
 }
 Poller::~Poller()
@@ -11,6 +18,30 @@ Poller::~Poller()
 
 bool Poller::hasChannal(Channal *channal) const
 {
-    auto it = channals_.find(channal->fd());
-    return it != channals_.end() && it->second == channal;
+    return channalAt(channal->fd()) == channal;
+}
+
+void Poller::setChannal(int fd, Channal *channal)
+{
+    size_t index = static_cast<size_t>(fd);
+    if (index >= channals_.size())
+    {
+        // 成倍扩大，fd连续增长时摊还O(1)
+        channals_.resize(std::max(index + 1, channals_.size() * 2), nullptr);
+    }
+    if (channals_[index] == nullptr)
+    {
+        ++numChannals_;
+    }
+    channals_[index] = channal;
+}
+
+void Poller::clearChannal(int fd)
+{
+    size_t index = static_cast<size_t>(fd);
+    if (index < channals_.size() && channals_[index] != nullptr)
+    {
+        channals_[index] = nullptr;
+        --numChannals_;
+    }
 }
\ No newline at end of file
@@ -4,7 +4,7 @@
 #include "Timestamp.h"
 
 #include <vector>
-#include <unordered_map>
+#include <stddef.h>
 
 class Channal;
 class EventLoop;
@@ -26,13 +26,26 @@ public:
     // 判断channal是否在当前的Poller中
     bool hasChannal(Channal *channal) const;
 
+    // 是否支持边沿触发的channal
+    virtual bool supportsEdgeTriggered() const { return false; }
+
     // EventLoop通过该接口获取IO复用的具体实现
     static Poller *newDefaultPoller(EventLoop *loop);
 
 protected:
-    // map的key：sockfd  value：sockfd所属的channal
-    using ChannalMap = std::unordered_map<int, Channal *>;
-    ChannalMap channals_;
+    // 以sockfd为下标的channal表，fd是内核从小到大分配的整数，直接下标访问，不需要哈希和节点分配
+    using ChannalTable = std::vector<Channal *>;
+
+    void setChannal(int fd, Channal *channal);
+    void clearChannal(int fd);
+    Channal *channalAt(int fd) const
+    {
+        return static_cast<size_t>(fd) < channals_.size() ? channals_[fd] : nullptr;
+    }
+    size_t numChannals() const { return numChannals_; }
+
+    ChannalTable channals_;
+    size_t numChannals_;
 
 private:
     EventLoop *ownerLoop_; // 定义Poller所属得到事件循环EventLoop
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <cstddef>
+
+/*
+ * 引用计数的只读数据片段，holder_持有底层内存的所有权
+ * 同一块数据可以同时挂在多个连接的发送队列中而不需要拷贝，最后一个引用释放时内存才被释放
+ */
+class Slice
+{
+public:
+    Slice()
+        : data_(nullptr),
+          len_(0)
+    {
+    }
+
+    Slice(std::shared_ptr<const void> holder, const char *data, size_t len)
+        : holder_(std::move(holder)),
+          data_(data),
+          len_(len)
+    {
+    }
+
+    // 接管string的内容
+    static Slice fromString(std::string &&str)
+    {
+        std::shared_ptr<std::string> holder = std::make_shared<std::string>(std::move(str));
+        return Slice(holder, holder->data(), holder->size());
+    }
+
+    const char *data() const { return data_; }
+    size_t size() const { return len_; }
+    bool empty() const { return len_ == 0; }
+
+    // 丢弃前n个字节，底层内存不变
+    void removePrefix(size_t n)
+    {
+        data_ += n;
+        len_ -= n;
+    }
+
+    const std::shared_ptr<const void> &holder() const { return holder_; }
+
+private:
+    std::shared_ptr<const void> holder_;
+    const char *data_;
+    size_t len_;
+};
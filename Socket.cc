@@ -7,6 +7,12 @@
 #include <sys/types.h>
 #include <strings.h>
 #include <netinet/tcp.h>
+#include <linux/filter.h>
+#include <errno.h>
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
 
 Socket::~Socket()
 {
@@ -53,6 +59,11 @@ void Socket::setTcpNoDelay(bool on)
     int optval = on ? 1 : 0;
     ::setsockopt(sockfd_, IPPROTO_TCP, TCP_NODELAY, &optval, sizeof optval);
 }
+void Socket::setTcpCork(bool on)
+{
+    int optval = on ? 1 : 0;
+    ::setsockopt(sockfd_, IPPROTO_TCP, TCP_CORK, &optval, sizeof optval);
+}
 void Socket::setReuseAddr(bool on)
 {
     int optval = on ? 1 : 0;
@@ -67,4 +78,28 @@ void Socket::setKeepAlive(bool on)
 {
     int optval = on ? 1 : 0;
     ::setsockopt(sockfd_, SOL_SOCKET, SO_KEEPALIVE, &optval, sizeof optval);
-}
\ No newline at end of file
+}
+bool Socket::setZeroCopy(bool on)
+{
+    int optval = on ? 1 : 0;
+    return ::setsockopt(sockfd_, SOL_SOCKET, SO_ZEROCOPY, &optval, sizeof optval) == 0;
+}
+
+bool Socket::attachReusePortCpuFilter(unsigned groupSize)
+{
+    // A = 当前cpu; A = A % groupSize; return A
+    struct sock_filter code[] = {
+        {BPF_LD | BPF_W | BPF_ABS, 0, 0, static_cast<__u32>(SKF_AD_OFF + SKF_AD_CPU)},
+        {BPF_ALU | BPF_MOD | BPF_K, 0, 0, groupSize},
+        {BPF_RET | BPF_A, 0, 0, 0},
+    };
+    struct sock_fprog prog;
+    prog.len = sizeof code / sizeof code[0];
+    prog.filter = code;
+    if (groupSize == 0 || ::setsockopt(sockfd_, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof prog) < 0)
+    {
+        LOG_ERROR("Socket::attachReusePortCpuFilter err:%d\n", errno);
+        return false;
+    }
+    return true;
+}
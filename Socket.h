@@ -22,9 +22,16 @@ public:
     void shutdownWrite();
 
     void setTcpNoDelay(bool on);
+    // 开启后内核攒满一个报文段才发送，关闭时立即发出剩余数据
+    void setTcpCork(bool on);
     void setReuseAddr(bool on);
     void setReusePort(bool on);
     void setKeepAlive(bool on);
+    // 开启SO_ZEROCOPY，之后才能使用MSG_ZEROCOPY发送，内核不支持时返回false
+    bool setZeroCopy(bool on);
+    // 给SO_REUSEPORT组挂上CBPF程序：新连接交给组中第(接收数据包的cpu % groupSize)个socket
+    // 组中socket的顺序就是listen的顺序，失败时返回false，内核仍按四元组哈希分配
+    bool attachReusePortCpuFilter(unsigned groupSize);
 
 private:
     const int sockfd_;
@@ -0,0 +1,15 @@
+#include "Task.h"
+
+const size_t Task::kInlineSize;
+
+static std::atomic<uint64_t> s_heapFallbacks(0);
+
+void Task::recordHeapFallback()
+{
+    s_heapFallbacks.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t Task::heapFallbacks()
+{
+    return s_heapFallbacks.load(std::memory_order_relaxed);
+}
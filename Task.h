@@ -0,0 +1,149 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <stdint.h>
+
+/*
+ * 只能移动的void()可调用对象，替代EventLoop中的std::function
+ * 大小不超过kInlineSize的闭包直接保存在对象内部，不需要堆分配，
+ * 如std::bind(&TcpConnection::xxx, shared_from_this(), ...)以及捕获少量变量的lambda
+ * 放不下的闭包退化为堆分配，heapFallbacks()记录退化的次数
+ * EventLoop投递队列的环写满、Task进入溢出队列时也会分配内存，同样记入heapFallbacks()
+ */
+class Task
+{
+public:
+    static const size_t kInlineSize = 64;
+
+    Task()
+        : ops_(nullptr)
+    {
+    }
+
+    template <typename F,
+              typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, Task>::value>::type>
+    Task(F &&f)
+        : ops_(nullptr)
+    {
+        using Functor = typename std::decay<F>::type;
+        construct<Functor>(std::forward<F>(f), std::integral_constant<bool, fitsInline<Functor>()>());
+    }
+
+    Task(Task &&rhs)
+        : ops_(rhs.ops_)
+    {
+        if (ops_)
+        {
+            ops_->move(&storage_, &rhs.storage_);
+            rhs.ops_ = nullptr;
+        }
+    }
+
+    Task &operator=(Task &&rhs)
+    {
+        if (this != &rhs)
+        {
+            reset();
+            if (rhs.ops_)
+            {
+                rhs.ops_->move(&storage_, &rhs.storage_);
+                ops_ = rhs.ops_;
+                rhs.ops_ = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+
+    ~Task() { reset(); }
+
+    void operator()() { ops_->invoke(&storage_); }
+    explicit operator bool() const { return ops_ != nullptr; }
+
+    void reset()
+    {
+        if (ops_)
+        {
+            ops_->destroy(&storage_);
+            ops_ = nullptr;
+        }
+    }
+
+    // 投递路径上的堆分配次数：闭包过大的Task，以及进入EventLoop溢出队列的Task
+    static uint64_t heapFallbacks();
+    static void recordHeapFallback();
+
+private:
+    using Storage = typename std::aligned_storage<kInlineSize, alignof(std::max_align_t)>::type;
+
+    struct Ops
+    {
+        void (*invoke)(void *storage);
+        void (*move)(void *dst, void *src); // 把src的闭包移到dst，并销毁src中的闭包
+        void (*destroy)(void *storage);
+    };
+
+    template <typename Functor>
+    static constexpr bool fitsInline()
+    {
+        return sizeof(Functor) <= kInlineSize &&
+               alignof(std::max_align_t) % alignof(Functor) == 0 &&
+               std::is_nothrow_move_constructible<Functor>::value;
+    }
+
+    template <typename Functor>
+    struct InlineOps
+    {
+        static void invoke(void *storage) { (*static_cast<Functor *>(storage))(); }
+        static void move(void *dst, void *src)
+        {
+            Functor *from = static_cast<Functor *>(src);
+            new (dst) Functor(std::move(*from));
+            from->~Functor();
+        }
+        static void destroy(void *storage) { static_cast<Functor *>(storage)->~Functor(); }
+
+        static const Ops ops;
+    };
+
+    template <typename Functor>
+    struct HeapOps
+    {
+        static Functor *get(void *storage) { return *static_cast<Functor **>(storage); }
+        static void invoke(void *storage) { (*get(storage))(); }
+        static void move(void *dst, void *src) { *static_cast<Functor **>(dst) = get(src); }
+        static void destroy(void *storage) { delete get(storage); }
+
+        static const Ops ops;
+    };
+
+    template <typename Functor, typename F>
+    void construct(F &&f, std::true_type)
+    {
+        new (&storage_) Functor(std::forward<F>(f));
+        ops_ = &InlineOps<Functor>::ops;
+    }
+
+    template <typename Functor, typename F>
+    void construct(F &&f, std::false_type)
+    {
+        *reinterpret_cast<Functor **>(&storage_) = new Functor(std::forward<F>(f));
+        ops_ = &HeapOps<Functor>::ops;
+        recordHeapFallback();
+    }
+
+    Storage storage_;
+    const Ops *ops_;
+};
+
+template <typename Functor>
+const Task::Ops Task::InlineOps<Functor>::ops = {&InlineOps<Functor>::invoke, &InlineOps<Functor>::move, &InlineOps<Functor>::destroy};
+
+template <typename Functor>
+const Task::Ops Task::HeapOps<Functor>::ops = {&HeapOps<Functor>::invoke, &HeapOps<Functor>::move, &HeapOps<Functor>::destroy};
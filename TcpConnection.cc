@@ -3,6 +3,7 @@
 #include "EventLoop.h"
 #include "Channal.h"
 #include "Socket.h"
+#include "IoUringPoller.h"
 
 #include <functional>
 #include <memory>
@@ -11,8 +12,20 @@
 #include <sys/types.h>
 #include <strings.h>
 #include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <string.h>
 #include <string>
 
+// 输入缓冲区数据处理完后，占用超过该大小的内存还给loop的内存池
+const size_t kMaxIdleInputBuffer = 4 * 1024;
+// 边沿触发时每次事件最多读写的字节数，保证同一个loop上其它连接的公平
+const size_t kEdgeTriggeredBudget = 256 * 1024;
+// 连接销毁后检查零拷贝完成通知的间隔
+const double kZeroCopyLingerInterval = 0.01;
+
 static EventLoop *CheckLoopNotNull(EventLoop *loop)
 {
     if (loop == nullptr)
@@ -31,8 +44,21 @@ TcpConnection::TcpConnection(EventLoop *loop, const std::string nameArg, int soc
       channal_(new Channal(loop_, sockfd)),
       localAddr_(localAddr),
       peerAddr_(peerAddr),
-      highWaterMark_(64 * 1024 * 1024) // 64 M
+      highWaterMark_(64 * 1024 * 1024), // 64 M
+      inputBuffer_(Buffer::kInitialSize, loop_->bufferPool()),
+      outputQueue_(loop_->bufferPool()),
+      flushScheduled_(false),
+      corkDepth_(0),
+      corkFlushQueued_(false),
+      edgeTriggeredRequested_(false),
+      completionRequested_(false),
+      completion_(nullptr),
+      recvId_(0),
+      sendInFlight_(false),
+      nextCompletionSeq_(0),
+      nextDeliverSeq_(0)
 {
+    loop_->connectionCreated();
 
      if (!socket_) {
         LOG_FATAL("Failed to create Socket for connection %s", name_.c_str());
@@ -55,6 +81,7 @@ TcpConnection::TcpConnection(EventLoop *loop, const std::string nameArg, int soc
     channal_->setWriteCallback(std::bind(&TcpConnection::handleWrite, this));
     channal_->setErrorCallback(std::bind(&TcpConnection::handleError, this));
     channal_->setCloseCallback(std::bind(&TcpConnection::handleClose, this));
+    channal_->setOwnerName(&name_);
 
     LOG_INFO("TcpConnection::ctor[%s] at fd=%d\n", name_.c_str(), sockfd);
     socket_->setKeepAlive(true);
@@ -67,20 +94,126 @@ TcpConnection::~TcpConnection()
 
 // 发送数据
 void TcpConnection::send(const std::string &buf)
+{
+    send(buf.data(), buf.size());
+}
+
+void TcpConnection::send(std::string &&buf)
 {
     if (state_ == kConnected)
     {
         if (loop_->isInLoopThread())
         {
-            sendInLoop(buf.c_str(), buf.size());
+            sendStringInLoop(buf);
         }
         else
         {
-            loop_->runInLoop(std::bind(&TcpConnection::sendInLoop, this, buf.c_str(), buf.size()));
+            {
+                std::lock_guard<std::mutex> lock(stagingMutex_);
+                stagingQueue_.append(std::move(buf));
+            }
+            scheduleFlush();
         }
     }
 }
 
+void TcpConnection::send(const void *data, size_t len)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->isInLoopThread())
+        {
+            sendInLoop(data, len);
+        }
+        else
+        {
+            // 拷贝一份交给loop线程，调用者的数据可能在发送前就被释放
+            {
+                std::lock_guard<std::mutex> lock(stagingMutex_);
+                stagingQueue_.append(static_cast<const char *>(data), len);
+            }
+            scheduleFlush();
+        }
+    }
+}
+
+void TcpConnection::send(Buffer *buf)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->isInLoopThread())
+        {
+            // 整个Buffer移入发送队列，小数据才会拷贝
+            checkHighWaterMark(buf->readableBytes());
+            outputQueue_.append(std::move(*buf));
+            flushOutputInLoop();
+        }
+        else
+        {
+            {
+                std::lock_guard<std::mutex> lock(stagingMutex_);
+                stagingQueue_.append(std::move(*buf));
+            }
+            scheduleFlush();
+        }
+    }
+}
+
+void TcpConnection::sendStringInLoop(std::string &buf)
+{
+    if (state_ == kDisConnected)
+    {
+        LOG_ERROR("disconnected,give up writing!");
+        return;
+    }
+    checkHighWaterMark(buf.size());
+    outputQueue_.append(std::move(buf));
+    flushOutputInLoop();
+}
+
+// 本批次的第一条数据负责登记一次flush，之后的数据只需追加到暂存队列
+void TcpConnection::scheduleFlush()
+{
+    if (!flushScheduled_.exchange(true))
+    {
+        loop_->queueInLoop(std::bind(&TcpConnection::flushStagedInLoop, shared_from_this()));
+    }
+}
+
+void TcpConnection::flushStagedInLoop()
+{
+    // 先清标记再取数据，清标记之前追加的数据一定会在本次取走，之后追加的会登记新的flush
+    flushScheduled_ = false;
+    OutputQueue staged;
+    {
+        std::lock_guard<std::mutex> lock(stagingMutex_);
+        staged.splice(stagingQueue_);
+    }
+    if (staged.empty())
+    {
+        return;
+    }
+    if (state_ == kDisConnected)
+    {
+        LOG_ERROR("disconnected,give up writing!");
+        return;
+    }
+
+    checkHighWaterMark(staged.memoryBytes());
+    outputQueue_.splice(staged);
+    flushOutputInLoop();
+}
+
+void TcpConnection::checkHighWaterMark(size_t len)
+{
+    // 目前发送缓冲区剩余的待发送数据的长度加上当前剩余要发送的数据高过水位线
+    size_t oldLen = outputQueue_.memoryBytes();
+    if (oldLen + len >= highWaterMark_ && oldLen < highWaterMark_ && highWaterMarkCallback_)
+    {
+        loop_->queueInLoop(std::bind(highWaterMarkCallback_, shared_from_this(), oldLen + len));
+    }
+}
+
 /*
  * 发送数据  应用写数据快，内核发送数据慢，需将数据写入发送缓冲区，且设置水位回调
  */
@@ -97,8 +230,9 @@ void TcpConnection::sendInLoop(const void *data, size_t len)
         return;
     }
 
-    // channal刚开始写数据，且发送缓冲区没有待发送数据
-    if (!channal_->isWriting() && outPutBuffer_.readableBytes() == 0)
+    // channal刚开始写数据，且发送缓冲区没有待发送数据，cork期间只追加不发送
+    // 完成模式下数据进入发送队列后提交sendmsg请求，不直接write
+    if (completion_ == nullptr && !channal_->isWriting() && outputQueue_.empty() && corkDepth_ == 0)
     {
         nwrote = ::write(channal_->fd(), data, len);
         if (nwrote >= 0)
@@ -129,22 +263,202 @@ void TcpConnection::sendInLoop(const void *data, size_t len)
     // ，直到TcpConnection发送缓冲区数据为空
     if (!faultError && remaining > 0)
     {
-        // 目前发送缓冲区剩余的待发送数据的长度
-        size_t oldLen = outPutBuffer_.readableBytes();
+        checkHighWaterMark(remaining);
+        outputQueue_.append((char *)data + nwrote, remaining);
+
+        if (completion_ != nullptr)
+        {
+            flushOutputInLoop();
+        }
+        else if (!channal_->isWriting() && corkDepth_ == 0)
+        {
+            channal_->enableWriting(); // 注册写事件，使channal能够调用handlewrite
+        }
+    }
+}
+
+void TcpConnection::sendFile(int fd, off_t offset, size_t len)
+{
+    if (state_ == kConnected)
+    {
+        int fileFd = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+        if (fileFd < 0)
+        {
+            LOG_ERROR("TcpConnection::sendFile dup fd=%d err:%d\n", fd, errno);
+            return;
+        }
+        if (loop_->isInLoopThread())
+        {
+            sendFileInLoop(fileFd, offset, len);
+        }
+        else
+        {
+            // 与其它线程的send进入同一个暂存队列，保持先后顺序
+            {
+                std::lock_guard<std::mutex> lock(stagingMutex_);
+                stagingQueue_.appendFile(fileFd, offset, len);
+            }
+            scheduleFlush();
+        }
+    }
+}
+
+void TcpConnection::sendFileInLoop(int fd, off_t offset, size_t len)
+{
+    if (state_ == kDisConnected)
+    {
+        ::close(fd);
+        LOG_ERROR("disconnected,give up sending file!");
+        return;
+    }
+
+    // 文件段排在已有数据之后，由发送队列保证顺序
+    outputQueue_.appendFile(fd, offset, len);
+    flushOutputInLoop();
+}
 
-        // 目前发送缓冲区剩余的待发送数据的长度加上当前剩余要发送的数据高过水位线
-        if (oldLen + remaining >= highWaterMark_ && oldLen < highWaterMark_ && highWaterMarkCallback_)
+void TcpConnection::send(const Slice &slice)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->isInLoopThread())
         {
-            loop_->queueInLoop(std::bind(highWaterMarkCallback_, shared_from_this(), oldLen + remaining));
+            sendSliceInLoop(slice);
         }
+        else
+        {
+            {
+                std::lock_guard<std::mutex> lock(stagingMutex_);
+                stagingQueue_.append(slice);
+            }
+            scheduleFlush();
+        }
+    }
+}
+
+void TcpConnection::sendSliceInLoop(const Slice &slice)
+{
+    if (state_ == kDisConnected)
+    {
+        LOG_ERROR("disconnected,give up writing!");
+        return;
+    }
 
-        outPutBuffer_.append((char *)data + nwrote, remaining);
+    checkHighWaterMark(slice.size());
+    outputQueue_.append(slice);
+    flushOutputInLoop();
+}
 
-        if (!channal_->isWriting())
+void TcpConnection::flushOutputInLoop()
+{
+    if (channal_->isWriting() || corkDepth_ > 0 || sendInFlight_)
+    {
+        return; // 等待EPOLLOUT时由handleWrite继续发送，cork时等待uncork，sendmsg请求完成后继续发送
+    }
+    if (completion_ != nullptr && submitSendInLoop())
+    {
+        return;
+    }
+
+    int savedError = 0;
+    ssize_t n = outputQueue_.writeFd(channal_->fd(), &savedError);
+    if (n < 0 && savedError != EWOULDBLOCK)
+    {
+        LOG_ERROR("TcpConnection::flushOutputInLoop err:%d\n", savedError);
+        if (savedError == EPIPE || savedError == ECONNRESET)
         {
-            channal_->enableWriting(); // 注册写事件，使channal能够调用handlewrite
+            return;
+        }
+    }
+
+    if (outputQueue_.empty())
+    {
+        if (writeCompleteCallback_)
+        {
+            loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
         }
     }
+    else
+    {
+        channal_->enableWriting();
+    }
+}
+
+void TcpConnection::cork()
+{
+    if (!loop_->isInLoopThread())
+    {
+        LOG_ERROR("TcpConnection::cork [%s] not in loop thread\n", name_.c_str());
+        return;
+    }
+    if (corkDepth_++ == 0 && !corkFlushQueued_)
+    {
+        // 保证积攒的数据最迟在本轮迭代结束时发出
+        corkFlushQueued_ = true;
+        loop_->queueInLoop(std::bind(&TcpConnection::corkTimeoutInLoop, shared_from_this()));
+    }
+}
+
+void TcpConnection::uncork()
+{
+    if (!loop_->isInLoopThread() || corkDepth_ == 0)
+    {
+        return;
+    }
+    if (--corkDepth_ == 0)
+    {
+        flushCorkedInLoop();
+    }
+}
+
+void TcpConnection::corkTimeoutInLoop()
+{
+    corkFlushQueued_ = false;
+    if (corkDepth_ > 0)
+    {
+        LOG_INFO("TcpConnection::corkTimeoutInLoop [%s] uncork at end of loop iteration\n", name_.c_str());
+        corkDepth_ = 0;
+        flushCorkedInLoop();
+    }
+}
+
+void TcpConnection::flushCorkedInLoop()
+{
+    if (state_ == kDisConnected || outputQueue_.empty())
+    {
+        return;
+    }
+    // 队列中有文件段时需要writev和sendfile多次系统调用，用TCP_CORK让内核把它们拼成完整的报文段
+    // 只有内存数据时一次writev即可发出，不需要额外的系统调用
+    bool hasFile = outputQueue_.readableBytes() > outputQueue_.memoryBytes();
+    if (hasFile)
+    {
+        socket_->setTcpCork(true);
+    }
+    flushOutputInLoop();
+    if (hasFile)
+    {
+        socket_->setTcpCork(false);
+    }
+}
+
+bool TcpConnection::setZeroCopy(bool on, size_t threshold)
+{
+    if (on && completion_ != nullptr)
+    {
+        // 零拷贝的完成通知需要监听socket的EPOLLERR，完成模式下没有挂poll请求
+        LOG_ERROR("TcpConnection::setZeroCopy [%s] not supported in io_uring completion mode\n", name_.c_str());
+        return false;
+    }
+    if (on && !socket_->setZeroCopy(true))
+    {
+        LOG_ERROR("TcpConnection::setZeroCopy [%s] SO_ZEROCOPY not supported err:%d\n", name_.c_str(), errno);
+        outputQueue_.setZeroCopyThreshold(0);
+        return false;
+    }
+    // 关闭时保留SO_ZEROCOPY，已发出的零拷贝数据仍需要读取完成通知
+    outputQueue_.setZeroCopyThreshold(on ? threshold : 0);
+    return true;
 }
 
 // 连接建立
@@ -152,10 +466,26 @@ void TcpConnection::connectEstablished()
 {
     setState(kConnected);
     channal_->tie(shared_from_this());
-    channal_->enableReading(); // 向poller注册读事件/epollin
+    IoUringPoller *poller = loop_->ioUringPoller();
+    if (completionRequested_ && poller != nullptr && poller->enableCompletion())
+    {
+        completion_ = poller;
+        sendIovecs_.resize(IOV_MAX);
+        submitRecvInLoop();
+    }
+    else
+    {
+        if (edgeTriggeredRequested_)
+        {
+            channal_->setEdgeTriggered(true);
+        }
+        channal_->enableReading(); // 向poller注册读事件/epollin
+    }
 
     // 新连接建立，执行回调
-    connectionCallback_(shared_from_this());
+    // 复制一份再调用：回调中可能替换connectionCallback_(如CoConnection)，原对象在执行中被销毁
+    ConnectionCallback cb = connectionCallback_;
+    cb(shared_from_this());
 }
 
 // 连接销毁
@@ -165,9 +495,64 @@ void TcpConnection::connectDestroyed()
     {
         setState(kDisConnected);
         channal_->disableAll(); // 从poller中将channal感兴趣的所有事件delete掉
-        connectionCallback_(shared_from_this());
+        ConnectionCallback cb = connectionCallback_;
+        cb(shared_from_this());
+    }
+    if (recvId_ != 0)
+    {
+        completion_->cancel(recvId_);
+        recvId_ = 0;
     }
     channal_->remove();
+    pendingCompletions_.clear(); // 回调中持有连接的shared_ptr
+    loop_->connectionDestroyed();
+
+    // 内核可能还在发送(或重传)零拷贝的数据，连接和socket保留到完成通知全部到达，
+    // 否则数据的内存被新连接复用，对端会收到错误的内容；channal已经移除，由定时器读取错误队列
+    if (outputQueue_.zeroCopyStats().pending > 0)
+    {
+        loop_->runAfter(kZeroCopyLingerInterval, std::bind(&TcpConnection::lingerZeroCopy, shared_from_this()));
+    }
+}
+
+void TcpConnection::lingerZeroCopy()
+{
+    outputQueue_.handleZeroCopyCompletions(channal_->fd());
+    if (outputQueue_.zeroCopyStats().pending > 0)
+    {
+        loop_->runAfter(kZeroCopyLingerInterval, std::bind(&TcpConnection::lingerZeroCopy, shared_from_this()));
+    }
+}
+
+void TcpConnection::completeInOrder(uint64_t seq, Task cb)
+{
+    // bind对象持有只能移动的Task，本身也只能移动，Task可以接收
+    loop_->runInLoop(std::bind(&TcpConnection::completeInOrderInLoop, shared_from_this(), seq, std::move(cb)));
+}
+
+void TcpConnection::completeInOrderInLoop(uint64_t seq, Task &cb)
+{
+    if (state_ == kDisConnected)
+    {
+        return;
+    }
+    if (seq != nextDeliverSeq_)
+    {
+        pendingCompletions_[seq] = std::move(cb);
+        return;
+    }
+    cb();
+    ++nextDeliverSeq_;
+    // 执行已经到达的后续回调
+    auto it = pendingCompletions_.begin();
+    while (it != pendingCompletions_.end() && it->first == nextDeliverSeq_ && state_ != kDisConnected)
+    {
+        Task next = std::move(it->second);
+        pendingCompletions_.erase(it);
+        next();
+        ++nextDeliverSeq_;
+        it = pendingCompletions_.begin();
+    }
 }
 
 // 关闭连接
@@ -183,20 +568,155 @@ void TcpConnection::shutdown()
 // 关闭连接
 void TcpConnection::shutdownInLoop()
 {
-    if(!channal_->isWriting())//channal的发送缓冲区的数据已经发送完成
+    if (corkDepth_ > 0)
+    {
+        // 关闭写端之前先发出cork积攒的数据
+        corkDepth_ = 0;
+        flushCorkedInLoop();
+    }
+    if(!channal_->isWriting() && !sendInFlight_)//channal的发送缓冲区的数据已经发送完成
     {
         socket_->shutdownWrite();//关闭写端
     }
 }
 
+void TcpConnection::submitRecvInLoop()
+{
+    // 回调只持有弱引用，连接销毁时取消请求
+    recvId_ = completion_->submitRecv(channal_->fd(),
+                                      std::bind(&TcpConnection::recvCompletion, std::weak_ptr<TcpConnection>(shared_from_this()),
+                                                std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4));
+    if (recvId_ == 0)
+    {
+        LOG_ERROR("TcpConnection::submitRecvInLoop [%s] failed\n", name_.c_str());
+    }
+}
+
+void TcpConnection::recvCompletion(const std::weak_ptr<TcpConnection> &weakConn, int res, const char *data, bool more, Timestamp receiveTime)
+{
+    TcpConnectionPtr conn(weakConn.lock());
+    if (conn)
+    {
+        conn->handleRecvCompletion(res, data, more, receiveTime);
+    }
+}
+
+void TcpConnection::handleRecvCompletion(int res, const char *data, bool more, Timestamp receiveTime)
+{
+    if (!more)
+    {
+        recvId_ = 0;
+    }
+    if (state_ == kDisConnected)
+    {
+        return;
+    }
+
+    if (res > 0)
+    {
+        // buffer ring的缓冲区在回调返回后就还给内核，数据拷入连接自己的输入缓冲区
+        inputBuffer_.append(data, res);
+        messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+        inputBuffer_.shrinkIfDrained(kMaxIdleInputBuffer);
+        if (!more && state_ != kDisConnected)
+        {
+            submitRecvInLoop(); // 内核结束了多次触发的请求，重新提交
+        }
+    }
+    else if (res == 0)
+    {
+        handleClose();
+    }
+    else if (res == -ENOBUFS)
+    {
+        // buffer ring暂时用完，本次poll回调结束后缓冲区会放回
+        submitRecvInLoop();
+    }
+    else if (res != -ECANCELED)
+    {
+        errno = -res;
+        LOG_ERROR("TcpConnection::handleRecvCompletion [%s] err:%d\n", name_.c_str(), errno);
+        handleClose();
+    }
+}
+
+bool TcpConnection::submitSendInLoop()
+{
+    size_t bytes = 0;
+    int iovcnt = outputQueue_.fillIovecs(sendIovecs_.data(), static_cast<int>(sendIovecs_.size()), &bytes);
+    if (iovcnt == 0)
+    {
+        return false; // 队首是文件段或零拷贝段，走就绪通知的发送路径
+    }
+
+    ::memset(&sendMsg_, 0, sizeof sendMsg_);
+    sendMsg_.msg_iov = sendIovecs_.data();
+    sendMsg_.msg_iovlen = iovcnt;
+    // 回调持有连接，请求完成前连接和发送队列中的数据都不会释放
+    uint64_t id = completion_->submitSend(channal_->fd(), &sendMsg_,
+                                          std::bind(&TcpConnection::handleSendCompletion, shared_from_this(), std::placeholders::_1));
+    if (id == 0)
+    {
+        return false;
+    }
+    sendInFlight_ = true;
+    outputQueue_.sealTail();
+    return true;
+}
+
+void TcpConnection::handleSendCompletion(int res)
+{
+    sendInFlight_ = false;
+    if (res < 0)
+    {
+        // 连接已经断开时由recv的完成事件关闭连接
+        LOG_ERROR("TcpConnection::handleSendCompletion [%s] err:%d\n", name_.c_str(), -res);
+        return;
+    }
+
+    outputQueue_.retrieve(res);
+    if (state_ == kDisConnected)
+    {
+        return;
+    }
+    if (!outputQueue_.empty())
+    {
+        flushOutputInLoop();
+    }
+    else
+    {
+        if (writeCompleteCallback_)
+        {
+            loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+        }
+        if (state_ == kDisConnecting)
+        {
+            shutdownInLoop();
+        }
+    }
+}
+
+bool TcpConnection::edgeTriggered() const
+{
+    return channal_->edgeTriggered();
+}
+
 void TcpConnection::handleRead(Timestamp receiveTime)
 {
+    if (channal_->edgeTriggered())
+    {
+        handleReadEdgeTriggered(receiveTime);
+        return;
+    }
+
     int savedError = 0;
     ssize_t n = inputBuffer_.readFd(channal_->fd(), &savedError);
     if (n > 0)
     {
         // 已建立连接的客户端，发生可读事件，调用用户传入的回调操作
         messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+        // 突发流量撑大的缓冲区，数据处理完后还给内存池
+        inputBuffer_.shrinkIfDrained(kMaxIdleInputBuffer);
     }
     else if (n == 0)
     {
@@ -209,33 +729,78 @@ void TcpConnection::handleRead(Timestamp receiveTime)
         handleError();
     }
 }
+// 边沿触发：一直读到EAGAIN，否则剩下的数据(包括EOF)不会再有通知
+void TcpConnection::handleReadEdgeTriggered(Timestamp receiveTime)
+{
+    size_t total = 0;
+    bool eof = false;
+    int savedError = 0;
+    while (total < kEdgeTriggeredBudget)
+    {
+        ssize_t n = inputBuffer_.readFd(channal_->fd(), &savedError);
+        if (n > 0)
+        {
+            total += n;
+        }
+        else
+        {
+            eof = n == 0;
+            break;
+        }
+    }
+
+    if (total > 0)
+    {
+        messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+        inputBuffer_.shrinkIfDrained(kMaxIdleInputBuffer);
+    }
+
+    if (eof)
+    {
+        handleClose();
+    }
+    else if (total >= kEdgeTriggeredBudget)
+    {
+        channal_->requeue(EPOLLIN); // 预算用完还没有读空，下一轮继续
+    }
+    else if (savedError != EAGAIN && savedError != EWOULDBLOCK)
+    {
+        errno = savedError;
+        LOG_ERROR("TcpConnectioon::handleReadEdgeTriggered err:%d\n", errno);
+        handleError();
+    }
+}
+
 void TcpConnection::handleWrite()
 {
     if (channal_->isWriting())
     {
         int savedError = 0;
-        ssize_t n = outPutBuffer_.writeFd(channal_->fd(), &savedError);
+        // 发送队列以writev/sendfile批量发送，一直写到队列为空或内核发送缓冲区写满
+        // 边沿触发时每次事件最多写预算的字节，socket仍可写时不会再有EPOLLOUT，需要requeue
+        bool edge = channal_->edgeTriggered();
+        ssize_t n = outputQueue_.writeFd(channal_->fd(), &savedError, edge ? kEdgeTriggeredBudget : 0);
 
-        if (n > 0)
+        if (n < 0 && savedError != EWOULDBLOCK)
         {
-
-            outPutBuffer_.retrieve(n);
-            if (outPutBuffer_.readableBytes() == 0)
-            {
-                channal_->disableWriting();
-                if (writeCompleteCallback_)
-                {
-                    loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
-                }
-                if (state_ = kDisConnecting)
-                {
-                    shutdownInLoop();
-                }
-            }
+            LOG_ERROR("TcpConnection::handlWrite");
         }
-        else
+        // n为-1(EAGAIN)时socket已写满，等待下一次EPOLLOUT边沿，不能requeue，否则每轮都空转
+        else if (edge && n > 0 && !outputQueue_.empty() && static_cast<size_t>(n) >= kEdgeTriggeredBudget)
         {
-            LOG_ERROR("TcpConnection::handlWrite");
+            channal_->requeue(EPOLLOUT);
+        }
+        else if (outputQueue_.empty())
+        {
+            channal_->disableWriting();
+            if (writeCompleteCallback_)
+            {
+                loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+            }
+            if (state_ == kDisConnecting)
+            {
+                shutdownInLoop();
+            }
         }
     }
     else
@@ -243,6 +808,7 @@ void TcpConnection::handleWrite()
         LOG_ERROR("TcpConnection fd=%d is down, no more writing\n", channal_->fd());
     }
 }
+
 void TcpConnection::handleClose()
 {
     LOG_INFO("TcpConnection::handleClose() fd=%d state=%d\n", channal_->fd(), (int)state_);
@@ -252,9 +818,10 @@ void TcpConnection::handleClose()
     TcpConnectionPtr connPtr(shared_from_this());
 
     // 执行连接关闭的回调
-    if (connectionCallback_)
+    ConnectionCallback connectionCallback = connectionCallback_;
+    if (connectionCallback)
     {
-        connectionCallback_(connPtr);
+        connectionCallback(connPtr);
     }
     // 执行关闭连接的回调
     if (closeCallback_)
@@ -264,6 +831,9 @@ void TcpConnection::handleClose()
 }
 void TcpConnection::handleError()
 {
+    // 零拷贝发送的完成通知通过socket错误队列送达，同样以EPOLLERR的形式通知
+    int completions = outputQueue_.handleZeroCopyCompletions(channal_->fd());
+
     int optval;
     socklen_t optlen = sizeof optval;
     int err = 0;
@@ -275,5 +845,9 @@ void TcpConnection::handleError()
     {
         err = optval;
     }
+    if (err == 0 && completions > 0)
+    {
+        return;
+    }
     LOG_ERROR("TcpConnection::handleError() name:%s - SO_ERROR:%d\n", name_.c_str(), err);
 }
\ No newline at end of file
@@ -4,15 +4,25 @@
 #include "InetAddress.h"
 #include "Callbacks.h"
 #include "Buffer.h"
+#include "OutputQueue.h"
 #include "Timestamp.h"
+#include "Task.h"
 
 #include <memory>
 #include <string>
+#include <vector>
 #include <atomic>
+#include <mutex>
+#include <map>
+#include <functional>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
 
 class Channal;
 class EventLoop;
 class Socket;
+class IoUringPoller;
 
 class TcpConnection : noncopyable, public std::enable_shared_from_this<TcpConnection>
 {
@@ -29,7 +39,24 @@ public:
     bool connected() const { return state_ == kConnected; }
 
     // 发送数据
+    // 在loop线程中直接发送；在其它线程中调用时，数据的所有权移交给连接的暂存队列，调用返回后即可释放原数据
+    // 同一批跨线程发送的数据在loop本轮迭代结束时合并发送，只唤醒loop一次
     void send(const std::string &buf);
+    void send(std::string &&buf);
+    void send(const void *data, size_t len);
+    // 取走buf中的全部数据，存储直接移交给发送队列，调用后buf为空但可以继续使用
+    void send(Buffer *buf);
+    // 通过sendfile发送文件fd中[offset, offset+len)的内容，与前后send的数据保持顺序
+    // fd会被dup一份，调用返回后调用者即可关闭自己的fd；发送完后触发writeCompleteCallback
+    void sendFile(int fd, off_t offset, size_t len);
+    // 发送引用计数的数据片段，数据不拷贝，发送完成前一直持有引用
+    void send(const Slice &slice);
+    // 合并发送：cork之后send的数据只进入发送队列，uncork时一次writev发出，可以嵌套
+    // 只能在loop线程中调用；忘记uncork时，在loop本轮迭代结束时自动发送
+    void cork();
+    void uncork();
+    bool corked() const { return corkDepth_ > 0; }
+
     // 关闭连接
     void shutdown();
 
@@ -39,6 +66,30 @@ public:
     void setHighWaterMarkCallback(const HighWaterMarkCallback &cb) { highWaterMarkCallback_ = cb; }
     void setCloseCallback(const CloseCallback &cb) { closeCallback_ = cb; }
 
+    // 边沿触发模式，需在connectEstablished之前设置；读写都进行到EAGAIN，EPOLLOUT一直注册
+    // 每次事件最多读写kEdgeTriggeredBudget字节，没有读写完的在loop下一轮迭代中继续
+    void setEdgeTriggered(bool on) { edgeTriggeredRequested_ = on; }
+    bool edgeTriggered() const;
+
+    // 每次读事件最多连续读取的字节数，读满一次后继续读直到读空或达到预算，0表示每次只读一次
+    void setReadBudget(size_t bytes) { inputBuffer_.setReadBudget(bytes); }
+    // 不小于threshold的string/slice使用MSG_ZEROCOPY发送，需在连接所属loop线程调用(如connectionCallback中)
+    // 内核不支持SO_ZEROCOPY时返回false，继续使用普通发送
+    bool setZeroCopy(bool on, size_t threshold = OutputQueue::kDefaultZeroCopyThreshold);
+    OutputQueue::ZeroCopyStats zeroCopyStats() const { return outputQueue_.zeroCopyStats(); }
+
+    // io_uring完成模式，需在connectEstablished之前设置；所属loop不是io_uring后端时仍使用就绪通知
+    // 接收由多次触发的recv完成，数据从loop共享的buffer ring拷入inputBuffer_后照常回调messageCallback
+    // 发送直接提交sendmsg请求，文件段仍通过sendfile发送；完成模式下不支持零拷贝
+    void setIoUringCompletion(bool on) { completionRequested_ = on; }
+    bool ioUringCompletion() const { return completion_ != nullptr; }
+
+    // 按序完成：在loop线程中用reserveCompletion取得序号，之后可以在任意线程中completeInOrder，
+    // 回调按序号的顺序在loop线程中执行；连接断开后到达的回调被丢弃
+    // cb只需要能移动，可以携带只能移动的结果
+    uint64_t reserveCompletion() { return nextCompletionSeq_++; }
+    void completeInOrder(uint64_t seq, Task cb);
+
     // 连接建立
     void connectEstablished();
     // 连接销毁
@@ -56,16 +107,42 @@ private:
     void setState(StateE state) { state_ = state; }
 
     void handleRead(Timestamp receiveTime);
+    void handleReadEdgeTriggered(Timestamp receiveTime);
     void handleWrite();
     void handleClose();
     void handleError();
 
     // 发送数据
     void sendInLoop(const void *message, size_t len);
+    void sendStringInLoop(std::string &buf);
+    // 其它线程的send先追加到暂存队列，每批只向loop登记一次flush
+    void scheduleFlush();
+    void flushStagedInLoop();
+    void sendFileInLoop(int fd, off_t offset, size_t len);
+    void sendSliceInLoop(const Slice &slice);
+    // 待发送数据即将增加len字节，超过高水位时通知
+    void checkHighWaterMark(size_t len);
+    // 发送队列新加入数据后调用，没有在等待EPOLLOUT且没有cork时立即尝试发送
+    void flushOutputInLoop();
+    // 发出cork期间积攒的数据
+    void flushCorkedInLoop();
+    void corkTimeoutInLoop();
+
+    // 完成模式的recv/send
+    void submitRecvInLoop();
+    static void recvCompletion(const std::weak_ptr<TcpConnection> &weakConn, int res, const char *data, bool more, Timestamp receiveTime);
+    void handleRecvCompletion(int res, const char *data, bool more, Timestamp receiveTime);
+    // 把队首的内存数据段提交为一个sendmsg请求，无法提交时返回false
+    bool submitSendInLoop();
+    void handleSendCompletion(int res);
 
     // 关闭连接
     void shutdownInLoop();
 
+    void completeInOrderInLoop(uint64_t seq, Task &cb);
+    // 连接销毁后定期读取零拷贝完成通知，全部完成后才释放连接
+    void lingerZeroCopy();
+
     EventLoop *loop_;
     const std::string name_;
     std::atomic_int state_;
@@ -85,5 +162,43 @@ private:
     size_t highWaterMark_;
 
     Buffer inputBuffer_;  // 接收数据的缓冲区
-    Buffer outPutBuffer_; // 发送数据的缓冲区
-};
\ No newline at end of file
+    OutputQueue outputQueue_; // 待发送数据的队列
+
+    std::mutex stagingMutex_;
+    OutputQueue stagingQueue_;        // 其它线程send的数据，loop线程flush时整体移入outputQueue_
+    std::atomic_bool flushScheduled_; // 已经向loop登记了flush
+
+    int corkDepth_;        // cork嵌套的层数
+    bool corkFlushQueued_; // 已经登记了本轮迭代结束时的自动发送
+
+    bool edgeTriggeredRequested_;
+
+    bool completionRequested_;
+    IoUringPoller *completion_;           // 完成模式下为loop的IoUringPoller
+    uint64_t recvId_;                     // 进行中的recv请求，0表示没有
+    bool sendInFlight_;                   // 有sendmsg请求等待完成，完成前不发起新的发送
+    struct msghdr sendMsg_;
+    std::vector<struct iovec> sendIovecs_; // 进行中的sendmsg引用的数据
+
+    uint64_t nextCompletionSeq_;                                  // 下一个分配的序号
+    uint64_t nextDeliverSeq_;                                     // 下一个应该执行的序号
+    std::map<uint64_t, Task> pendingCompletions_;                  // 提前到达、等待前面序号的回调
+};
+
+// 作用域内的send合并为一次发送
+class CorkGuard : noncopyable
+{
+public:
+    explicit CorkGuard(const TcpConnectionPtr &conn)
+        : conn_(conn)
+    {
+        conn_->cork();
+    }
+    ~CorkGuard()
+    {
+        conn_->uncork();
+    }
+
+private:
+    TcpConnectionPtr conn_;
+};
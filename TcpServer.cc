@@ -3,6 +3,7 @@
 #include "TcpConnection.h"
 
 #include <functional>
+#include <future>
 #include <strings.h>
 
 static EventLoop *CheckLoopNotNull(EventLoop *loop)
@@ -14,8 +15,27 @@ static EventLoop *CheckLoopNotNull(EventLoop *loop)
     return loop;
 }
 
+// 在loop线程中执行cb并等待其完成
+static void runInLoopAndWait(EventLoop *loop, const std::function<void()> &cb)
+{
+    if (loop->isInLoopThread())
+    {
+        cb();
+        return;
+    }
+    std::promise<void> done;
+    std::future<void> future = done.get_future();
+    loop->runInLoop([&cb, &done]() {
+        cb();
+        done.set_value();
+    });
+    future.wait();
+}
+
 TcpServer::TcpServer(EventLoop *loop, const InetAddress &listenAddr, const std::string nameArg, Option option)
     : loop_(CheckLoopNotNull(loop)),
+      listenAddr_(listenAddr),
+      reusePort_(option == kReusePort),
       ipPort_(listenAddr.toIpPort()),
       name_(nameArg),
       acceptor_(new Acceptor(loop_, listenAddr, option == kReusePort)),
@@ -23,7 +43,11 @@ TcpServer::TcpServer(EventLoop *loop, const InetAddress &listenAddr, const std::
       connectionCallback_(),
       messageCallback_(),
       nextConnId_(1),
-      started_(0)
+      started_(0),
+      perLoopAcceptors_(false),
+      cpuSteering_(false),
+      edgeTriggered_(false),
+      ioUringCompletion_(false)
 
 {
     // 新用户连接时执行
@@ -33,6 +57,12 @@ TcpServer::TcpServer(EventLoop *loop, const InetAddress &listenAddr, const std::
 
 TcpServer::~TcpServer()
 {
+    // subloop中的监听socket和连接在各自的loop线程中销毁
+    for (std::unique_ptr<LoopAcceptor> &loopAcceptor : loopAcceptors_)
+    {
+        runInLoopAndWait(loopAcceptor->loop, std::bind(&TcpServer::destroyLoopAcceptor, this, loopAcceptor.get()));
+    }
+
     for(auto &item :connections_)
     {
         TcpConnectionPtr conn(item.second);//在 item reset后,conn在出作用域后可以析构new出来的TcpConnection
@@ -59,23 +89,55 @@ void TcpServer::setThreadNum(int numThreads)
     threadPool_->setTreadNum(numThreads);
 }
 
+void TcpServer::setIoUringCompletion(bool on)
+{
+    ioUringCompletion_ = on;
+    acceptor_->setMultishotAccept(on);
+}
+
+// 绑定subloop和baseloop线程的CPU
+void TcpServer::setThreadCpus(const std::vector<int> &cpus, int baseLoopCpu, bool bindNuma)
+{
+    threadPool_->setThreadCpus(cpus);
+    threadPool_->setBaseLoopCpu(baseLoopCpu);
+    threadPool_->setNumaBind(bindNuma);
+}
+
+void TcpServer::setDispatchPolicy(LoopDispatcher::Policy policy)
+{
+    threadPool_->setDispatchPolicy(policy);
+}
+
 // 开启服务器监听
 void TcpServer::start()
 {
     if (started_++ == 0)
     {
         threadPool_->start(threadInitCallback_);
-        loop_->runInLoop(std::bind(&Acceptor::listen, acceptor_.get()));
+        if (!perLoopAcceptors_ || !startLoopAcceptors())
+        {
+            loop_->runInLoop(std::bind(&Acceptor::listen, acceptor_.get()));
+        }
     }
 }
 
 void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
 {
-    // 轮询选择一个subloop管理新建立的channal
-    EventLoop *ioLoop = threadPool_->getNextLoop();
+    // 按分配策略选择一个subloop管理新建立的channal
+    EventLoop *ioLoop = threadPool_->getLoopForConnection(peerAddr);
+    TcpConnectionPtr conn = createConnection(ioLoop, sockfd, peerAddr);
+    connections_[conn->name()] = conn;
+
+    // 设置如何关闭连接的回调
+    conn->setCloseCallback(std::bind(&TcpServer::removeConnection, this, std::placeholders::_1));
+    // 直接调用TcpConnection的connectEstablished
+    ioLoop->runInLoop(std::bind(&TcpConnection::connectEstablished, conn));
+}
+
+TcpConnectionPtr TcpServer::createConnection(EventLoop *ioLoop, int sockfd, const InetAddress &peerAddr)
+{
     char buf[64] = {0};
-    snprintf(buf, sizeof buf, ipPort_.c_str(), nextConnId_);
-    ++nextConnId_;
+    snprintf(buf, sizeof buf, "-%s#%d", ipPort_.c_str(), nextConnId_++);
     std::string connName = name_ + buf;
 
     LOG_INFO("TcpServer::newConncetion[%s] - new connection [%s] fron %s\n", name_.c_str(), connName.c_str(), peerAddr.toIpPort().c_str());
@@ -97,16 +159,13 @@ void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
                                             sockfd,
                                             localAddr,
                                             peerAddr));
-    connections_[connName] = conn;
     // 设置用户提供的连接回调,用户=》TcpServer =》TcpConnection =》channal
     conn->setConnectionCallback(connectionCallback_);
     conn->setMessageCallback(messageCallback_);
     conn->setWriteCompleteCallback(writeCompleteCallback_);
-
-    // 设置如何关闭连接的回调
-    conn->setCloseCallback(std::bind(&TcpServer::removeConnection, this, std::placeholders::_1));
-    // 直接调用TcpConnection的connectEstablished
-    ioLoop->runInLoop(std::bind(&TcpConnection::connectEstablished, conn));
+    conn->setEdgeTriggered(edgeTriggered_);
+    conn->setIoUringCompletion(ioUringCompletion_);
+    return conn;
 }
 
 void TcpServer::removeConnection(const TcpConnectionPtr &conn)
@@ -121,4 +180,72 @@ void TcpServer::removeConnectionInLoop(const TcpConnectionPtr &conn)
     connections_.erase(conn->name());
     EventLoop *ioLoop = conn->getLoop();
     ioLoop->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
-}
\ No newline at end of file
+}
+
+bool TcpServer::startLoopAcceptors()
+{
+    if (!reusePort_)
+    {
+        LOG_ERROR("TcpServer[%s] per-loop acceptors need kReusePort, accept in baseloop\n", name_.c_str());
+        return false;
+    }
+    std::vector<EventLoop *> loops = threadPool_->getAllLoops();
+    if (loops.size() == 1 && loops[0] == loop_)
+    {
+        LOG_ERROR("TcpServer[%s] per-loop acceptors need subloops, accept in baseloop\n", name_.c_str());
+        return false;
+    }
+
+    // acceptor_已经绑定了地址但不listen，只是占住端口，不会分到连接
+    for (EventLoop *loop : loops)
+    {
+        LoopAcceptor *loopAcceptor = new LoopAcceptor;
+        loopAcceptor->loop = loop;
+        loopAcceptor->acceptor.reset(new Acceptor(loop, listenAddr_, true));
+        loopAcceptor->acceptor->setNewConnectionCallback(std::bind(&TcpServer::newLoopConnection, this, loopAcceptor, std::placeholders::_1, std::placeholders::_2));
+        loopAcceptor->acceptor->setMultishotAccept(ioUringCompletion_);
+        loopAcceptors_.push_back(std::unique_ptr<LoopAcceptor>(loopAcceptor));
+        // 依次listen，SO_REUSEPORT组中socket的顺序与subloop的顺序一致
+        runInLoopAndWait(loop, std::bind(&TcpServer::listenInLoop, this, loopAcceptor));
+    }
+
+    if (cpuSteering_ && !loopAcceptors_[0]->acceptor->attachCpuSteering(static_cast<unsigned>(loops.size())))
+    {
+        LOG_ERROR("TcpServer[%s] cpu steering unavailable, kernel hashes connections to loops\n", name_.c_str());
+    }
+    return true;
+}
+
+void TcpServer::listenInLoop(LoopAcceptor *loopAcceptor)
+{
+    loopAcceptor->acceptor->listen();
+}
+
+// 在接收连接的subloop中直接建立连接
+void TcpServer::newLoopConnection(LoopAcceptor *loopAcceptor, int sockfd, const InetAddress &peerAddr)
+{
+    TcpConnectionPtr conn = createConnection(loopAcceptor->loop, sockfd, peerAddr);
+    loopAcceptor->connections[conn->name()] = conn;
+    conn->setCloseCallback(std::bind(&TcpServer::removeLoopConnection, this, loopAcceptor, std::placeholders::_1));
+    conn->connectEstablished();
+}
+
+void TcpServer::removeLoopConnection(LoopAcceptor *loopAcceptor, const TcpConnectionPtr &conn)
+{
+    LOG_INFO("TcpServer::removeLoopConnection [%s] - connection %s\n", name_.c_str(), conn->name().c_str());
+
+    loopAcceptor->connections.erase(conn->name());
+    loopAcceptor->loop->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+}
+
+void TcpServer::destroyLoopAcceptor(LoopAcceptor *loopAcceptor)
+{
+    loopAcceptor->acceptor.reset();
+    for (auto &item : loopAcceptor->connections)
+    {
+        TcpConnectionPtr conn(item.second);
+        item.second.reset();
+        conn->connectDestroyed();
+    }
+    loopAcceptor->connections.clear();
+}
@@ -8,12 +8,14 @@
 #include "Callbacks.h"
 #include "TcpConnection.h"
 #include "Buffer.h"
+#include "CpuAffinity.h"
 
 #include <functional>
 #include <string>
 #include <memory>
 #include <atomic>
 #include <unordered_map>
+#include <vector>
 
 // 对外服务器编程使用的类
 class TcpServer : noncopyable
@@ -37,18 +39,59 @@ public:
     // 设置底层subloop的个数
     void setThreadNum(int numThreads);
 
+    // 连接使用边沿触发，需在start之前设置；只对epoll后端生效
+    void setEdgeTriggered(bool on) { edgeTriggered_ = on; }
+
+    // io_uring完成模式：accept和连接的收发都直接提交io_uring请求，需在start之前设置
+    // 只对使用io_uring后端(MUDUO_USE_IOURING)的loop生效，其它loop仍使用就绪通知
+    void setIoUringCompletion(bool on);
+
+    // cpu亲和性，需在start之前设置：subloop依次固定到cpus中的核上(cpus可以用CpuAffinity::parseCpuList解析)，
+    // baseloop固定到baseLoopCpu上；bindNuma时loop的内存优先分配在所在的NUMA节点
+    void setThreadCpus(const std::vector<int> &cpus, int baseLoopCpu = -1, bool bindNuma = false);
+
+    // 新连接分配到subloop的策略，默认轮询
+    void setDispatchPolicy(LoopDispatcher::Policy policy);
+
+    // 每个subloop各自监听同一地址(SO_REUSEPORT)，内核把新连接分给各个loop，连接直接在接收它的loop中建立，
+    // 不经过baseloop；需以kReusePort构造并且setThreadNum>0，否则仍由baseloop接收。需在start之前设置
+    // cpuSteering时挂上CBPF程序，连接交给第(接收数据包的cpu % subloop个数)个subloop，
+    // 配合setThreadCpus把第i个subloop固定在对应的cpu上，连接的处理留在接收其数据包的cpu上
+    void setPerLoopAcceptors(bool on, bool cpuSteering = false)
+    {
+        perLoopAcceptors_ = on;
+        cpuSteering_ = cpuSteering;
+    }
+
     // 开启服务器监听
     void start();
 
 private:
+    using ConnectionMap = std::unordered_map<std::string, TcpConnectionPtr>;
+
+    // subloop自己的监听socket和在该loop中建立的连接，只在该loop线程中访问
+    struct LoopAcceptor
+    {
+        EventLoop *loop;
+        std::unique_ptr<Acceptor> acceptor;
+        ConnectionMap connections;
+    };
+
     void newConnection(int sockfd, const InetAddress &peerAddr);
     void removeConnection(const TcpConnectionPtr &conn);
     void removeConnectionInLoop(const TcpConnectionPtr &conn);
 
-    using ConnectionMap = std::unordered_map<std::string, TcpConnectionPtr>;
+    TcpConnectionPtr createConnection(EventLoop *ioLoop, int sockfd, const InetAddress &peerAddr);
+    bool startLoopAcceptors();
+    void listenInLoop(LoopAcceptor *loopAcceptor);
+    void newLoopConnection(LoopAcceptor *loopAcceptor, int sockfd, const InetAddress &peerAddr);
+    void removeLoopConnection(LoopAcceptor *loopAcceptor, const TcpConnectionPtr &conn);
+    void destroyLoopAcceptor(LoopAcceptor *loopAcceptor);
 
     EventLoop *loop_; // 用户创建的baseloop/mainloop
 
+    const InetAddress listenAddr_;
+    const bool reusePort_;
     const std::string ipPort_;
     const std::string name_;
 
@@ -64,6 +107,13 @@ private:
 
     std::atomic_int started_;
 
-    int nextConnId_;
+    std::atomic_int nextConnId_; // 每个loop都可能建立连接
     ConnectionMap connections_;
+
+    bool perLoopAcceptors_;
+    bool cpuSteering_;
+    std::vector<std::unique_ptr<LoopAcceptor>> loopAcceptors_;
+
+    bool edgeTriggered_;
+    bool ioUringCompletion_;
 };
\ No newline at end of file
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Timestamp.h"
+#include "Callbacks.h"
+#include "Channal.h"
+#include "TimerId.h"
+
+#include <set>
+#include <vector>
+#include <utility>
+
+class EventLoop;
+class Timer;
+
+/*
+ * 定时器队列，每个EventLoop一个
+ * 所有定时器按到期时间保存在有序集合中，只用一个timerfd设置为最早的到期时间，
+ * timerfd作为Channal注册到loop的poller上，可读时一次取出所有到期的定时器执行
+ * 添加和取消都是O(logN)，可以在任意线程调用，实际操作转到loop线程中执行
+ */
+class TimerQueue : noncopyable
+{
+public:
+    explicit TimerQueue(EventLoop *loop);
+    ~TimerQueue();
+
+    // 在when时刻执行cb，interval大于0时每隔interval秒重复执行
+    TimerId addTimer(TimerCallback cb, Timestamp when, double interval);
+    void cancel(TimerId timerId);
+
+private:
+    using Entry = std::pair<Timestamp, Timer *>;
+    using TimerList = std::set<Entry>;
+    using ActiveTimer = std::pair<Timer *, int64_t>;
+    using ActiveTimerSet = std::set<ActiveTimer>;
+
+    void addTimerInLoop(Timer *timer);
+    void cancelInLoop(TimerId timerId);
+    // timerfd可读时调用
+    void handleRead();
+    // 取出所有已经到期的定时器
+    std::vector<Entry> getExpired(Timestamp now);
+    // 重复的定时器重新加入队列，并重设timerfd
+    void reset(const std::vector<Entry> &expired, Timestamp now);
+    // 返回新的定时器是否成为最早到期的一个
+    bool insert(Timer *timer);
+
+    EventLoop *loop_;
+    const int timerfd_;
+    Channal timerfdChannal_;
+
+    TimerList timers_;          // 按到期时间排序
+    ActiveTimerSet activeTimers_; // 按地址排序，用于取消，与timers_保存相同的定时器
+
+    bool callingExpiredTimers_;
+    ActiveTimerSet cancelingTimers_; // 执行到期回调期间被取消的定时器，不再重新加入队列
+};
@@ -1,6 +1,9 @@
 #include "Timestamp.h"
 
 #include <time.h>
+#include <sys/time.h>
+
+const int64_t Timestamp::kMicroSecondsPerSecond;
 
 Timestamp::Timestamp() : microSecondSinceEpoch_(0) {};
 
@@ -8,13 +11,17 @@ Timestamp::Timestamp(int64_t mirmicroSecondSinceEpoch) : microSecondSinceEpoch_(
 
 Timestamp Timestamp::now()
 {
-    return Timestamp(time(NULL));
+    struct timeval tv;
+    ::gettimeofday(&tv, NULL);
+    return Timestamp(tv.tv_sec * kMicroSecondsPerSecond + tv.tv_usec);
 }
 
 std::string Timestamp::toString() const
 {
     char buf[128] = {0};
-    tm *tm_time = localtime(&microSecondSinceEpoch_);
+    time_t seconds = static_cast<time_t>(microSecondSinceEpoch_ / kMicroSecondsPerSecond);
+    tm tm_buf;
+    tm *tm_time = localtime_r(&seconds, &tm_buf);
     snprintf(buf, 128, "%4d/%02d/%02d %02d:%02d:%02d",
              tm_time->tm_year + 1900,
              tm_time->tm_mon + 1,
@@ -1,8 +1,10 @@
 #pragma once
 
 #include <iostream>
+#include <string>
+#include <stdint.h>
 
-//时间类
+//时间类，精度为微秒
 class Timestamp
 {
 public:
@@ -11,9 +13,39 @@ public:
     explicit Timestamp(int64_t microSecondSinceEpoch);
 
     static Timestamp now();
+    static Timestamp invalid() { return Timestamp(); }
 
     std::string toString() const;
 
+    bool valid() const { return microSecondSinceEpoch_ > 0; }
+    int64_t microSecondsSinceEpoch() const { return microSecondSinceEpoch_; }
+
+    static const int64_t kMicroSecondsPerSecond = 1000 * 1000;
+
 private:
     int64_t microSecondSinceEpoch_;
-};
\ No newline at end of file
+};
+
+inline bool operator<(Timestamp lhs, Timestamp rhs)
+{
+    return lhs.microSecondsSinceEpoch() < rhs.microSecondsSinceEpoch();
+}
+
+inline bool operator==(Timestamp lhs, Timestamp rhs)
+{
+    return lhs.microSecondsSinceEpoch() == rhs.microSecondsSinceEpoch();
+}
+
+// 两个时间点相差的秒数
+inline double timeDifference(Timestamp high, Timestamp low)
+{
+    int64_t diff = high.microSecondsSinceEpoch() - low.microSecondsSinceEpoch();
+    return static_cast<double>(diff) / Timestamp::kMicroSecondsPerSecond;
+}
+
+// 时间点加上seconds秒
+inline Timestamp addTime(Timestamp timestamp, double seconds)
+{
+    int64_t delta = static_cast<int64_t>(seconds * Timestamp::kMicroSecondsPerSecond);
+    return Timestamp(timestamp.microSecondsSinceEpoch() + delta);
+}
@@ -0,0 +1,298 @@
+#include "Watchdog.h"
+#include "EventLoop.h"
+#include "Channal.h"
+#include "Logger.h"
+#include "CurrentThread.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <execinfo.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <utility>
+
+static const int kMaxFrames = 64;
+static const int kMaxOwnerName = 128;
+static const int kCaptureWaitMs = 100; // 等待被卡住线程响应信号的最长时间
+
+// 一次调用栈获取，由信号处理函数在被卡住的线程中填写
+struct StackCapture
+{
+    std::atomic<EventLoop *> loop; // 为空时信号处理函数什么也不做
+    std::atomic<bool> done;
+    void *frames[kMaxFrames];
+    int depth;
+    char ownerName[kMaxOwnerName];
+};
+
+static StackCapture g_capture;
+static std::mutex g_captureMutex; // 多个看门狗共用同一个信号，一次只获取一个线程的调用栈
+
+Watchdog::Watchdog(double thresholdSeconds, const std::string &name)
+    : thresholdSeconds_(thresholdSeconds),
+      stallCallback_(&Watchdog::logReport),
+      captureStack_(true),
+      running_(false),
+      reporting_(nullptr),
+      thread_(std::bind(&Watchdog::threadFunc, this), name)
+{
+}
+
+Watchdog::~Watchdog()
+{
+    stop();
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (Watched &watched : loops_)
+    {
+        watched.loop->watchdog_.store(nullptr);
+    }
+}
+
+void Watchdog::watch(EventLoop *loop)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    Watched watched;
+    watched.loop = loop;
+    watched.lastHeartbeat = loop->heartbeat_.load(std::memory_order_relaxed);
+    watched.lastChange = Timestamp::now();
+    watched.reported = false;
+    loops_.push_back(watched);
+    loop->watchdog_.store(this);
+}
+
+void Watchdog::unwatch(EventLoop *loop)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (auto it = loops_.begin(); it != loops_.end(); ++it)
+    {
+        if (it->loop == loop)
+        {
+            loops_.erase(it);
+            break;
+        }
+    }
+    // 报告在看门狗线程中进行，从回调中unwatch时等待会死锁
+    if (CurrentThread::tid() != thread_.tid())
+    {
+        while (reporting_ == loop)
+        {
+            reportDone_.wait(lock);
+        }
+    }
+    Watchdog *self = this;
+    loop->watchdog_.compare_exchange_strong(self, nullptr);
+}
+
+int Watchdog::stackSignal()
+{
+    return SIGRTMIN + 2;
+}
+
+void Watchdog::start()
+{
+    if (captureStack_)
+    {
+        static std::once_flag installed;
+        std::call_once(installed, []() {
+            struct sigaction sa;
+            memset(&sa, 0, sizeof sa);
+            sa.sa_handler = &Watchdog::stackSignalHandler;
+            sa.sa_flags = SA_RESTART;
+            sigemptyset(&sa.sa_mask);
+            if (::sigaction(stackSignal(), &sa, nullptr) < 0)
+            {
+                LOG_ERROR("Watchdog sigaction error:%d\n", errno);
+            }
+            // backtrace第一次调用时会加载libgcc，不能发生在信号处理函数中
+            void *frames[1];
+            ::backtrace(frames, 1);
+        });
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = true;
+    }
+    thread_.start();
+}
+
+void Watchdog::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_)
+        {
+            return;
+        }
+        running_ = false;
+    }
+    cond_.notify_all();
+    thread_.join();
+}
+
+void Watchdog::threadFunc()
+{
+    // 检查间隔为阈值的1/4，报告的卡顿时长最多比实际晚这么多
+    int64_t intervalUs = std::max<int64_t>(static_cast<int64_t>(thresholdSeconds_ * 1000 * 1000 / 4), 1000);
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (running_)
+    {
+        cond_.wait_for(lock, std::chrono::microseconds(intervalUs));
+        if (running_)
+        {
+            check(lock, Timestamp::now());
+        }
+    }
+}
+
+void Watchdog::check(std::unique_lock<std::mutex> &lock, Timestamp now)
+{
+    // 在锁中找出需要报告的loop，报告时释放锁
+    std::vector<std::pair<EventLoop *, double>> stalled;
+    for (Watched &watched : loops_)
+    {
+        EventLoop *loop = watched.loop;
+        uint64_t heartbeat = loop->heartbeat_.load(std::memory_order_relaxed);
+        if (loop->activity_.load(std::memory_order_relaxed) == EventLoop::kPolling || heartbeat != watched.lastHeartbeat)
+        {
+            watched.lastHeartbeat = heartbeat;
+            watched.lastChange = now;
+            watched.reported = false;
+        }
+        else if (!watched.reported && timeDifference(now, watched.lastChange) >= thresholdSeconds_)
+        {
+            // 同一次卡顿只报告一次
+            watched.reported = true;
+            stalled.push_back(std::make_pair(watched.loop, timeDifference(now, watched.lastChange)));
+        }
+    }
+
+    for (const std::pair<EventLoop *, double> &entry : stalled)
+    {
+        // 之前的报告期间loop可能已经被unwatch，析构的loop不能再访问
+        if (!running_ || !isWatching(entry.first))
+        {
+            continue;
+        }
+        reporting_ = entry.first;
+        lock.unlock();
+        report(entry.first, entry.second);
+        lock.lock();
+        reporting_ = nullptr;
+        reportDone_.notify_all();
+    }
+}
+
+bool Watchdog::isWatching(EventLoop *loop) const
+{
+    for (const Watched &watched : loops_)
+    {
+        if (watched.loop == loop)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// 不持有mutex_，reporting_保证期间loop不会被unwatch后析构
+void Watchdog::report(EventLoop *loop, double stalledSeconds)
+{
+    StallReport report;
+    report.loop = loop;
+    report.tid = loop->threadId_;
+    report.stalledSeconds = stalledSeconds;
+
+    // 先记录loop正在执行的内容，发送信号后被打断的sleep等调用可能提前结束
+    char buf[256];
+    int activity = loop->activity_.load(std::memory_order_relaxed);
+    int fd = loop->currentFd_.load(std::memory_order_relaxed);
+    if (activity == EventLoop::kPendingFunctors)
+    {
+        snprintf(buf, sizeof buf, "running pending functor %lu of %lu",
+                 static_cast<unsigned long>(loop->currentFunctor_.load(std::memory_order_relaxed) + 1),
+                 static_cast<unsigned long>(loop->functorBatch_.load(std::memory_order_relaxed)));
+    }
+    else
+    {
+        snprintf(buf, sizeof buf, "handling channal fd=%d", fd);
+    }
+    report.activity = buf;
+
+    std::string ownerName;
+    if (captureStack_)
+    {
+        std::lock_guard<std::mutex> lock(g_captureMutex);
+        g_capture.done.store(false);
+        g_capture.depth = 0;
+        g_capture.ownerName[0] = '\0';
+        g_capture.loop.store(loop);
+        if (::syscall(SYS_tgkill, ::getpid(), report.tid, stackSignal()) == 0)
+        {
+            for (int i = 0; i < kCaptureWaitMs && !g_capture.done.load(); ++i)
+            {
+                ::usleep(1000);
+            }
+        }
+        // 超时后信号处理函数看到loop为空就不再写入
+        g_capture.loop.store(nullptr);
+        if (g_capture.done.load())
+        {
+            char **symbols = ::backtrace_symbols(g_capture.frames, g_capture.depth);
+            if (symbols != nullptr)
+            {
+                report.backtrace.assign(symbols, symbols + g_capture.depth);
+                ::free(symbols);
+            }
+            ownerName = g_capture.ownerName;
+        }
+    }
+
+    if (!ownerName.empty())
+    {
+        report.activity += " conn=" + ownerName;
+    }
+
+    if (stallCallback_)
+    {
+        stallCallback_(report);
+    }
+}
+
+void Watchdog::stackSignalHandler(int)
+{
+    EventLoop *loop = g_capture.loop.load();
+    if (loop == nullptr || !loop->isInLoopThread() || g_capture.done.load())
+    {
+        return;
+    }
+    int savedErrno = errno;
+    g_capture.depth = ::backtrace(g_capture.frames, kMaxFrames);
+    // 在loop线程中，currentChannal_指向的channal此时一定还活着
+    Channal *channal = loop->activity_.load(std::memory_order_relaxed) == EventLoop::kHandlingEvents ? loop->currentChannal_ : nullptr;
+    const std::string *name = channal != nullptr ? channal->ownerName() : nullptr;
+    size_t n = 0;
+    if (name != nullptr)
+    {
+        n = std::min(name->size(), static_cast<size_t>(kMaxOwnerName - 1));
+        memcpy(g_capture.ownerName, name->data(), n);
+    }
+    g_capture.ownerName[n] = '\0';
+    g_capture.done.store(true);
+    errno = savedErrno;
+}
+
+void Watchdog::logReport(const StallReport &report)
+{
+    // 日志缓冲区有限，调用栈逐行输出
+    LOG_ERROR("EventLoop %p (tid %d) stalled for %.3fs: %s\n",
+              report.loop, static_cast<int>(report.tid), report.stalledSeconds, report.activity.c_str());
+    for (size_t i = 0; i < report.backtrace.size(); ++i)
+    {
+        LOG_ERROR("  #%lu %s\n", static_cast<unsigned long>(i), report.backtrace[i].c_str());
+    }
+}
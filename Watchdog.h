@@ -0,0 +1,87 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Thread.h"
+#include "Timestamp.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <stdint.h>
+#include <sys/types.h>
+
+class EventLoop;
+
+/*
+ * EventLoop卡顿检测：后台线程定期检查每个被监视loop的心跳(每处理一个io事件或回调加一)
+ * loop不在poll中等待、心跳超过阈值没有变化时，报告loop正在执行什么：
+ * 哪个channal fd及其所属的TcpConnection，或者一批回调中的第几个，并附上被卡住线程的调用栈
+ *
+ * 调用栈通过向loop线程发送stackSignal()信号、在信号处理函数中backtrace获取，
+ * 信号会让被卡住线程中正在进行的sleep等调用提前返回一次，不需要时可以setCaptureStack(false)
+ * 看门狗需要比被监视的loop活得久，loop析构时自动unwatch
+ * 获取调用栈和执行回调时不持有锁，回调中可以watch/unwatch；unwatch会等待正在进行的对该loop的报告结束
+ */
+class Watchdog : noncopyable
+{
+public:
+    struct StallReport
+    {
+        EventLoop *loop;
+        pid_t tid;                          // loop所在线程
+        double stalledSeconds;              // 心跳停止的时长
+        std::string activity;               // 正在执行的内容
+        std::vector<std::string> backtrace; // 被卡住线程的调用栈，获取不到时为空
+    };
+    using StallCallback = std::function<void(const StallReport &)>;
+
+    // 心跳停止超过thresholdSeconds秒视为卡顿
+    explicit Watchdog(double thresholdSeconds = 0.1, const std::string &name = "Watchdog");
+    ~Watchdog();
+
+    // 可以在任意线程调用；通常在TcpServer的ThreadInitCallback中watch每个subloop
+    void watch(EventLoop *loop);
+    // 返回后看门狗不再访问loop；在卡顿回调中调用时不等待(正在进行的就是这个回调所在的报告)
+    void unwatch(EventLoop *loop);
+
+    // 默认以LOG_ERROR输出报告，需在start之前设置
+    void setStallCallback(const StallCallback &cb) { stallCallback_ = cb; }
+    void setCaptureStack(bool on) { captureStack_ = on; }
+
+    void start();
+    void stop();
+
+    // 用来获取调用栈的信号
+    static int stackSignal();
+
+private:
+    struct Watched
+    {
+        EventLoop *loop;
+        uint64_t lastHeartbeat;
+        Timestamp lastChange; // 心跳最后一次变化(或者回到poll)的时间
+        bool reported;        // 本次卡顿已经报告过
+    };
+
+    void threadFunc();
+    void check(std::unique_lock<std::mutex> &lock, Timestamp now);
+    void report(EventLoop *loop, double stalledSeconds);
+    bool isWatching(EventLoop *loop) const;
+    // 在被卡住的线程中执行：记录调用栈和正在处理的连接名
+    static void stackSignalHandler(int sig);
+    static void logReport(const StallReport &report);
+
+    const double thresholdSeconds_;
+    StallCallback stallCallback_;
+    bool captureStack_;
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    bool running_;
+    std::vector<Watched> loops_;
+    EventLoop *reporting_;                // 正在报告(不持有锁)的loop
+    std::condition_variable reportDone_; // reporting_清空时通知等待的unwatch
+    Thread thread_;
+};
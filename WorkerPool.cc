@@ -0,0 +1,204 @@
+#include "WorkerPool.h"
+#include "Thread.h"
+#include "Logger.h"
+
+#include <stdio.h>
+
+// 当前线程所属的线程池及其中的序号，用于把工作线程中提交的任务放入自己的队列
+static __thread WorkerPool *t_pool = nullptr;
+static __thread size_t t_index = 0;
+
+WorkerPool::WorkerPool(int numThreads, const std::string &name)
+    : name_(name),
+      next_(0),
+      pending_(0),
+      idle_(0),
+      submitted_(0),
+      running_(false)
+{
+    if (numThreads <= 0)
+    {
+        LOG_FATAL("WorkerPool %s numThreads %d\n", name.c_str(), numThreads);
+    }
+    for (int i = 0; i < numThreads; ++i)
+    {
+        std::unique_ptr<Worker> worker(new Worker);
+        worker->depth.store(0, std::memory_order_relaxed);
+        worker->maxDepth.store(0, std::memory_order_relaxed);
+        worker->executed.store(0, std::memory_order_relaxed);
+        worker->steals.store(0, std::memory_order_relaxed);
+        workers_.push_back(std::move(worker));
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    stop();
+}
+
+void WorkerPool::start()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        running_ = true;
+    }
+    for (size_t i = 0; i < workers_.size(); ++i)
+    {
+        char buf[name_.size() + 32];
+        snprintf(buf, sizeof buf, "%s%lu", name_.c_str(), static_cast<unsigned long>(i));
+        workers_[i]->thread.reset(new Thread(std::bind(&WorkerPool::workerFunc, this, i), buf));
+        workers_[i]->thread->start();
+    }
+}
+
+void WorkerPool::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        if (!running_)
+        {
+            return;
+        }
+        running_ = false;
+        cond_.notify_all();
+    }
+    for (std::unique_ptr<Worker> &worker : workers_)
+    {
+        worker->thread->join();
+    }
+}
+
+void WorkerPool::run(Task task)
+{
+    size_t index = t_pool == this ? t_index : next_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+    submitted_.fetch_add(1, std::memory_order_relaxed);
+    // 先增加pending_再入队，工作线程看到pending_为0时一定没有漏掉任务
+    pending_.fetch_add(1);
+    push(index, std::move(task));
+    if (idle_.load() > 0)
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        cond_.notify_one();
+    }
+}
+
+void WorkerPool::push(size_t index, Task task)
+{
+    Worker &worker = *workers_[index];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    worker.tasks.push_back(std::move(task));
+    size_t depth = worker.tasks.size();
+    worker.depth.store(depth, std::memory_order_relaxed);
+    if (depth > worker.maxDepth.load(std::memory_order_relaxed))
+    {
+        worker.maxDepth.store(depth, std::memory_order_relaxed);
+    }
+}
+
+bool WorkerPool::popLocal(size_t index, Task &task)
+{
+    Worker &worker = *workers_[index];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (worker.tasks.empty())
+    {
+        return false;
+    }
+    task = std::move(worker.tasks.front());
+    worker.tasks.pop_front();
+    worker.depth.store(worker.tasks.size(), std::memory_order_relaxed);
+    return true;
+}
+
+bool WorkerPool::steal(size_t thief, Task &task)
+{
+    size_t n = workers_.size();
+    for (size_t i = 1; i < n; ++i)
+    {
+        Worker &victim = *workers_[(thief + i) % n];
+        // 先无锁地跳过空队列
+        if (victim.depth.load(std::memory_order_relaxed) == 0)
+        {
+            continue;
+        }
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty())
+        {
+            // 从队尾窃取，队首留给所有者按提交顺序执行
+            task = std::move(victim.tasks.back());
+            victim.tasks.pop_back();
+            victim.depth.store(victim.tasks.size(), std::memory_order_relaxed);
+            Worker &self = *workers_[thief];
+            self.steals.store(self.steals.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkerPool::workerFunc(size_t index)
+{
+    t_pool = this;
+    t_index = index;
+    Worker &self = *workers_[index];
+    Task task;
+    for (;;)
+    {
+        if (popLocal(index, task) || steal(index, task))
+        {
+            pending_.fetch_sub(1);
+            task();
+            task.reset();
+            self.executed.store(self.executed.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            continue;
+        }
+
+        // 先登记idle_再检查pending_，与run中先增加pending_再检查idle_配合，不会错过唤醒
+        std::unique_lock<std::mutex> lock(sleepMutex_);
+        idle_.fetch_add(1);
+        while (pending_.load() == 0 && running_)
+        {
+            cond_.wait(lock);
+        }
+        idle_.fetch_sub(1);
+        if (pending_.load() == 0 && !running_)
+        {
+            break;
+        }
+    }
+    t_pool = nullptr;
+}
+
+WorkerPool::Stats WorkerPool::stats() const
+{
+    Stats stats;
+    stats.submitted = submitted_.load(std::memory_order_relaxed);
+    stats.executed = 0;
+    stats.steals = 0;
+    stats.queued = 0;
+    for (const std::unique_ptr<Worker> &worker : workers_)
+    {
+        size_t depth = worker->depth.load(std::memory_order_relaxed);
+        stats.executed += worker->executed.load(std::memory_order_relaxed);
+        stats.steals += worker->steals.load(std::memory_order_relaxed);
+        stats.queued += depth;
+        stats.queueDepths.push_back(depth);
+        stats.maxQueueDepths.push_back(worker->maxDepth.load(std::memory_order_relaxed));
+    }
+    return stats;
+}
+
+std::string WorkerPool::Stats::toString() const
+{
+    char buf[128];
+    snprintf(buf, sizeof buf, "submitted=%lu executed=%lu steals=%lu queued=%lu depths=",
+             static_cast<unsigned long>(submitted), static_cast<unsigned long>(executed),
+             static_cast<unsigned long>(steals), static_cast<unsigned long>(queued));
+    std::string result = buf;
+    for (size_t i = 0; i < queueDepths.size(); ++i)
+    {
+        snprintf(buf, sizeof buf, "%s%lu/%lu", i == 0 ? "" : ",",
+                 static_cast<unsigned long>(queueDepths[i]), static_cast<unsigned long>(maxQueueDepths[i]));
+        result += buf;
+    }
+    return result;
+}
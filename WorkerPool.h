@@ -0,0 +1,132 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Task.h"
+#include "TcpConnection.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+class Thread;
+
+/*
+ * 计算线程池，用于把CPU密集的处理从io loop中移走
+ * 每个工作线程有自己的任务队列，从队首取任务；自己的队列为空时从其它线程的队尾窃取
+ * 外部提交的任务轮流放入各个队列，工作线程中提交的任务放入自己的队列
+ *
+ * submit(conn, work, done)在工作线程中执行work，结果回到连接所属的loop线程调用done，
+ * 同一连接的done按提交的顺序执行，与work完成的先后无关
+ */
+class WorkerPool : noncopyable
+{
+public:
+    struct Stats
+    {
+        uint64_t submitted;                 // 提交的任务数
+        uint64_t executed;                  // 执行完的任务数
+        uint64_t steals;                    // 从其它线程窃取的任务数
+        size_t queued;                      // 当前排队的任务数
+        std::vector<size_t> queueDepths;    // 各线程当前的队列长度
+        std::vector<size_t> maxQueueDepths; // 各线程队列长度的最大值
+
+        std::string toString() const;
+    };
+
+    explicit WorkerPool(int numThreads, const std::string &name = "WorkerPool");
+    ~WorkerPool();
+
+    void start();
+    // 执行完已经排队的任务后退出
+    void stop();
+
+    // 可以在任意线程调用
+    void run(Task task);
+
+    // 在连接所属loop线程中调用(如messageCallback中)：work()在工作线程中执行，
+    // 返回值R按序在loop线程中交给done(conn, R)，work返回void时调用done(conn)
+    // 连接已经销毁时work不再执行，连接断开时done被丢弃
+    template <typename Work, typename Done>
+    void submit(const TcpConnectionPtr &conn, Work work, Done done)
+    {
+        uint64_t seq = conn->reserveCompletion();
+        std::weak_ptr<TcpConnection> weakConn(conn);
+        run(std::bind(&WorkerPool::runAndComplete<Work, Done>, weakConn, seq, std::move(work), std::move(done)));
+    }
+
+    Stats stats() const;
+
+    size_t numThreads() const { return workers_.size(); }
+
+private:
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+        std::atomic<size_t> depth; // tasks.size()，在mutex中更新，可以无锁读取
+        std::atomic<size_t> maxDepth;
+        std::atomic<uint64_t> executed;
+        std::atomic<uint64_t> steals;
+        std::unique_ptr<Thread> thread;
+    };
+
+    template <typename Work, typename Done>
+    static void runAndComplete(const std::weak_ptr<TcpConnection> &weakConn, uint64_t seq, Work &work, Done &done)
+    {
+        TcpConnectionPtr conn = weakConn.lock();
+        if (conn)
+        {
+            complete(conn, seq, work, done, std::is_void<decltype(work())>());
+        }
+    }
+
+    // 在loop线程中把work的结果移动给done，结果可以只能移动
+    template <typename Done, typename Result>
+    struct Completion
+    {
+        Done done;
+        TcpConnectionPtr conn;
+        Result result;
+
+        void operator()() { done(conn, std::move(result)); }
+    };
+
+    // runAndComplete只执行一次，done可以从bind对象中移走
+    template <typename Work, typename Done>
+    static void complete(const TcpConnectionPtr &conn, uint64_t seq, Work &work, Done &done, std::false_type)
+    {
+        using Result = typename std::decay<decltype(work())>::type;
+        conn->completeInOrder(seq, Completion<Done, Result>{std::move(done), conn, work()});
+    }
+
+    template <typename Work, typename Done>
+    static void complete(const TcpConnectionPtr &conn, uint64_t seq, Work &work, Done &done, std::true_type)
+    {
+        work();
+        conn->completeInOrder(seq, std::bind(std::move(done), conn));
+    }
+
+    void workerFunc(size_t index);
+    void push(size_t index, Task task);
+    bool popLocal(size_t index, Task &task);
+    bool steal(size_t thief, Task &task);
+
+    const std::string name_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<size_t> next_;       // 外部提交时轮流选择队列
+    std::atomic<int64_t> pending_;   // 所有队列中的任务数，先于入队增加
+    std::atomic<int> idle_;          // 准备休眠或正在休眠的线程数
+    std::atomic<uint64_t> submitted_;
+
+    std::mutex sleepMutex_;
+    std::condition_variable cond_;
+    bool running_;
+};
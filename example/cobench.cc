@@ -0,0 +1,144 @@
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/Coroutine.h>
+#include <mymuduo/Timestamp.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * 对比同一个按行回显的服务用两种方式编写的开销
+ *   callback : 消息回调中从Buffer逐行取出并send
+ *   coroutine: 每个连接一个协程，co_await readUntil("\r\n")后co_await write
+ * 服务端是一个subloop，客户端在另一个线程中用阻塞socket，每个连接一次只有一行(64字节)在途
+ * 用法：cobench [连接数] [每个连接的请求数] [端口]
+ */
+
+static CoTask<void> echoSession(CoConnection conn)
+{
+    for (;;)
+    {
+        std::string line = co_await conn.readUntil("\r\n");
+        if (conn.closed() || !co_await conn.write(std::move(line)))
+        {
+            break;
+        }
+    }
+}
+
+static void onCallbackMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    const char *crlf;
+    while ((crlf = buf->findCRLF()) != nullptr)
+    {
+        conn->send(buf->retrieveAsString(crlf + 2 - buf->peek()));
+    }
+}
+
+// 返回每秒完成的请求数，出错返回-1
+static double runClient(uint16_t port, int conns, int rounds)
+{
+    std::vector<int> fds;
+    for (int i = 0; i < conns; ++i)
+    {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof addr) < 0)
+        {
+            perror("connect");
+            return -1;
+        }
+        int one = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+        fds.push_back(fd);
+    }
+
+    std::string line(62, 'a');
+    line += "\r\n";
+    char buf[4096];
+    bool ok = true;
+    Timestamp start(Timestamp::now());
+    for (int r = 0; r < rounds && ok; ++r)
+    {
+        for (size_t i = 0; i < fds.size() && ok; ++i)
+        {
+            ok = ::write(fds[i], line.data(), line.size()) == static_cast<ssize_t>(line.size());
+        }
+        for (size_t i = 0; i < fds.size() && ok; ++i)
+        {
+            size_t got = 0;
+            while (got < line.size() && ok)
+            {
+                ssize_t n = ::read(fds[i], buf, sizeof buf);
+                ok = n > 0;
+                got += ok ? n : 0;
+            }
+        }
+    }
+    double result = ok ? static_cast<double>(rounds) * conns / timeDifference(Timestamp::now(), start) : -1;
+    if (!ok)
+    {
+        perror("cobench client");
+    }
+    for (int fd : fds)
+    {
+        ::close(fd);
+    }
+    return result;
+}
+
+static double runServer(bool coroutine, uint16_t port, int conns, int rounds)
+{
+    EventLoop loop;
+    InetAddress addr(port);
+    TcpServer server(&loop, addr, coroutine ? "CoBench" : "CbBench");
+    server.setThreadNum(1);
+    if (coroutine)
+    {
+        server.setMessageCallback([](const TcpConnectionPtr &, Buffer *, Timestamp) {});
+        server.setConnectionCallback([](const TcpConnectionPtr &conn) {
+            if (conn->connected())
+            {
+                coSpawn(echoSession(CoConnection(conn)));
+            }
+        });
+    }
+    else
+    {
+        server.setConnectionCallback([](const TcpConnectionPtr &) {});
+        server.setMessageCallback(&onCallbackMessage);
+    }
+    server.start();
+
+    double result = -1;
+    std::thread client([&] {
+        result = runClient(port, conns, rounds);
+        loop.quit();
+    });
+    loop.loop();
+    client.join();
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    int conns = argc > 1 ? atoi(argv[1]) : 16;
+    int rounds = argc > 2 ? atoi(argv[2]) : 5000;
+    uint16_t port = static_cast<uint16_t>(argc > 3 ? atoi(argv[3]) : 9370);
+
+    double callback = runServer(false, port, conns, rounds);
+    double coroutine = runServer(true, port + 1, conns, rounds);
+    printf("callback : %d conns, %d rounds, %.0f req/s\n", conns, rounds, callback);
+    printf("coroutine: %d conns, %d rounds, %.0f req/s\n", conns, rounds, coroutine);
+    return 0;
+}
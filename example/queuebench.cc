@@ -0,0 +1,177 @@
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/EventLoopThread.h>
+#include <mymuduo/Task.h>
+#include <mymuduo/Timestamp.h>
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <memory>
+#include <new>
+
+/*
+ * 对比跨线程投递回调的两种方式
+ *   mutex: 原来的实现，每次投递加锁追加到vector，并写一次eventfd
+ *   mpsc : EventLoop::queueInLoop，无锁队列，loop处理回调之前最多写一次eventfd
+ * 同时统计投递期间全局operator new的调用次数，换算为每个回调的内存分配次数
+ * window>0时每个生产者最多有window个未执行的回调，模拟请求/响应式的投递；
+ * window为0时不限制，生产者持续快于loop时mpsc的环会写满，多出的回调进入溢出队列并分配内存
+ * 用法：queuebench [生产者线程数] [每个线程投递的回调数] [window]
+ */
+
+using Functor = std::function<void()>;
+
+static std::atomic<long> g_allocations(0);
+
+void *operator new(size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    void *p = ::malloc(size == 0 ? 1 : size);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    ::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    ::free(p);
+}
+
+class MutexQueueLoop
+{
+public:
+    MutexQueueLoop()
+        : wakeupFd_(::eventfd(0, EFD_CLOEXEC)),
+          quit_(false),
+          thread_(std::bind(&MutexQueueLoop::loop, this))
+    {
+    }
+    ~MutexQueueLoop()
+    {
+        queueInLoop([this] { quit_ = true; });
+        thread_.join();
+        ::close(wakeupFd_);
+    }
+
+    void queueInLoop(Functor cb)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pending_.push_back(std::move(cb));
+        }
+        uint64_t one = 1;
+        ssize_t n = ::write(wakeupFd_, &one, sizeof one);
+        (void)n;
+    }
+
+private:
+    void loop()
+    {
+        while (!quit_)
+        {
+            uint64_t count;
+            ssize_t n = ::read(wakeupFd_, &count, sizeof count);
+            (void)n;
+            std::vector<Functor> functors;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                functors.swap(pending_);
+            }
+            for (const Functor &functor : functors)
+            {
+                functor();
+            }
+        }
+    }
+
+    int wakeupFd_;
+    bool quit_;
+    std::mutex mutex_;
+    std::vector<Functor> pending_;
+    std::thread thread_;
+};
+
+template <typename Loop>
+double run(Loop *loop, int producers, int tasks, int window, double *allocsPerTask)
+{
+    std::atomic<long> done(0);
+    long total = static_cast<long>(producers) * tasks;
+    std::unique_ptr<std::atomic<int>[]> executed(new std::atomic<int>[producers]);
+    for (int i = 0; i < producers; ++i)
+    {
+        executed[i].store(0);
+    }
+    std::vector<std::thread> threads;
+    threads.reserve(producers);
+    long allocations = g_allocations.load();
+    Timestamp start(Timestamp::now());
+
+    for (int i = 0; i < producers; ++i)
+    {
+        std::atomic<int> *mine = &executed[i];
+        threads.emplace_back([loop, tasks, window, mine, &done] {
+            for (int j = 0; j < tasks; ++j)
+            {
+                while (window > 0 && j - mine->load(std::memory_order_acquire) >= window)
+                {
+                    std::this_thread::yield();
+                }
+                loop->queueInLoop([mine, &done] {
+                    mine->fetch_add(1, std::memory_order_release);
+                    done.fetch_add(1, std::memory_order_relaxed);
+                });
+            }
+        });
+    }
+    for (std::thread &t : threads)
+    {
+        t.join();
+    }
+    while (done.load() < total)
+    {
+        std::this_thread::yield();
+    }
+    double seconds = timeDifference(Timestamp::now(), start);
+    *allocsPerTask = static_cast<double>(g_allocations.load() - allocations) / total;
+    return seconds;
+}
+
+int main(int argc, char *argv[])
+{
+    int producers = argc > 1 ? atoi(argv[1]) : 4;
+    int tasks = argc > 2 ? atoi(argv[2]) : 1000000;
+    int window = argc > 3 ? atoi(argv[3]) : 0;
+    double total = static_cast<double>(producers) * tasks;
+
+    {
+        MutexQueueLoop loop;
+        double allocs;
+        double seconds = run(&loop, producers, tasks, window, &allocs);
+        printf("mutex: %d producers, window %d, %.0f tasks, %.3fs, %.2f M tasks/s, %.3f allocs/task\n",
+               producers, window, total, seconds, total / seconds / 1e6, allocs);
+    }
+    {
+        EventLoopThread thread;
+        EventLoop *loop = thread.startLoop();
+        double allocs;
+        uint64_t fallbacks = Task::heapFallbacks();
+        double seconds = run(loop, producers, tasks, window, &allocs);
+        printf("mpsc : %d producers, window %d, %.0f tasks, %.3fs, %.2f M tasks/s, %.3f allocs/task, %lu heap fallbacks\n",
+               producers, window, total, seconds, total / seconds / 1e6, allocs,
+               static_cast<unsigned long>(Task::heapFallbacks() - fallbacks));
+    }
+    return 0;
+}
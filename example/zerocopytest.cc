@@ -0,0 +1,157 @@
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/Logger.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * 通过loopback检查MSG_ZEROCOPY发送
+ * 服务端对每个连接开启零拷贝，发送若干个大string后立即shutdown，这是最容易在内核完成之前释放数据的用法
+ * 客户端依次建立连接，读到EOF并校验每个字节(各连接的填充字节不同，数据被新连接复用会校验失败)
+ * 最后检查：每个连接的完成通知数加上未完成数等于发送数，所有连接在完成通知到齐后都已释放
+ * 用法：zerocopytest [连接数] [每个连接的string数] [string长度] [端口]
+ */
+
+static int g_conns = 8;
+static int g_rounds = 16;
+static size_t g_size = 1024 * 1024;
+
+static std::atomic<int> g_clientDone(0);
+static std::atomic<int> g_badConns(0);
+static int g_nextConn = 0;
+static uint64_t g_sends = 0;
+static uint64_t g_completions = 0;
+static uint64_t g_copied = 0;
+static bool g_countsMatch = true;
+static std::vector<std::weak_ptr<TcpConnection>> g_released;
+
+static char fillByte(int index)
+{
+    return static_cast<char>('a' + index % 26);
+}
+
+static void onConnection(const TcpConnectionPtr &conn)
+{
+    if (conn->connected())
+    {
+        if (!conn->setZeroCopy(true, 64 * 1024))
+        {
+            LOG_ERROR("SO_ZEROCOPY not supported\n");
+        }
+        char fill = fillByte(g_nextConn++);
+        for (int i = 0; i < g_rounds; ++i)
+        {
+            conn->send(std::string(g_size, fill));
+        }
+        conn->shutdown();
+        g_released.push_back(conn);
+    }
+    else
+    {
+        OutputQueue::ZeroCopyStats stats = conn->zeroCopyStats();
+        g_sends += stats.sends;
+        g_completions += stats.completions;
+        g_copied += stats.copied;
+        if (stats.completions + stats.pending != stats.sends)
+        {
+            g_countsMatch = false;
+        }
+        printf("%s: sends=%lu completions=%lu copied=%lu pending=%lu at close\n", conn->name().c_str(),
+               static_cast<unsigned long>(stats.sends), static_cast<unsigned long>(stats.completions),
+               static_cast<unsigned long>(stats.copied), static_cast<unsigned long>(stats.pending));
+    }
+}
+
+// 依次建立连接，读到EOF并校验内容
+static void runClient(uint16_t port)
+{
+    std::vector<char> buf(64 * 1024);
+    for (int c = 0; c < g_conns; ++c)
+    {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof addr) < 0)
+        {
+            perror("connect");
+            ::close(fd);
+            ++g_badConns;
+            continue;
+        }
+        char fill = fillByte(c);
+        size_t total = 0;
+        bool ok = true;
+        ssize_t n;
+        while ((n = ::read(fd, buf.data(), buf.size())) > 0)
+        {
+            for (ssize_t i = 0; i < n && ok; ++i)
+            {
+                ok = buf[i] == fill;
+            }
+            total += n;
+        }
+        ::close(fd);
+        if (!ok || total != g_size * g_rounds)
+        {
+            printf("conn %d: received %lu bytes, content %s\n", c, static_cast<unsigned long>(total), ok ? "ok" : "CORRUPTED");
+            ++g_badConns;
+        }
+    }
+    g_clientDone = 1;
+}
+
+int main(int argc, char *argv[])
+{
+    g_conns = argc > 1 ? atoi(argv[1]) : g_conns;
+    g_rounds = argc > 2 ? atoi(argv[2]) : g_rounds;
+    g_size = argc > 3 ? static_cast<size_t>(atol(argv[3])) : g_size;
+    uint16_t port = static_cast<uint16_t>(argc > 4 ? atoi(argv[4]) : 9380);
+
+    EventLoop loop;
+    InetAddress addr(port);
+    TcpServer server(&loop, addr, "ZeroCopyTest");
+    server.setConnectionCallback(&onConnection);
+    server.setMessageCallback([](const TcpConnectionPtr &, Buffer *buf, Timestamp) { buf->retrieveAll(); });
+    server.start();
+
+    std::thread client(std::bind(&runClient, port));
+    // 客户端结束后等待所有连接释放(完成通知到齐)，最多等5秒
+    Timestamp deadline = addTime(Timestamp::now(), 5.0);
+    bool released = false;
+    loop.runEvery(0.05, [&] {
+        if (!g_clientDone)
+        {
+            deadline = addTime(Timestamp::now(), 5.0);
+            return;
+        }
+        released = true;
+        for (const std::weak_ptr<TcpConnection> &conn : g_released)
+        {
+            released = released && conn.expired();
+        }
+        if (released || timeDifference(Timestamp::now(), deadline) > 0)
+        {
+            loop.quit();
+        }
+    });
+    loop.loop();
+    client.join();
+
+    bool pass = g_badConns == 0 && g_countsMatch && released && g_sends > 0;
+    printf("total: sends=%lu completions(at close)=%lu copied=%lu, bad conns=%d, all released=%s\n",
+           static_cast<unsigned long>(g_sends), static_cast<unsigned long>(g_completions),
+           static_cast<unsigned long>(g_copied), g_badConns.load(), released ? "yes" : "no");
+    printf("%s\n", pass ? "PASS" : "FAIL");
+    return pass ? 0 : 1;
+}